@@ -0,0 +1,55 @@
+# Turns a SPIR-V binary into a header holding it as an aligned constexpr word
+# array, see src/shaderCode.hpp. Run in script mode:
+#
+#   cmake -DINPUT=<file.spv> -DOUTPUT=<file.hpp> -DSYMBOL=<identifier>
+#         -DNAME=<shader file name> -P embedSpirv.cmake
+
+file(READ ${INPUT} SPIRV_HEX HEX)
+string(LENGTH "${SPIRV_HEX}" HEX_LENGTH)
+math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+if(HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+  message(FATAL_ERROR "${INPUT} is not a SPIR-V binary")
+endif()
+
+# the file holds little-endian words, the literals are written most
+# significant byte first
+set(HEX_BYTE "[0-9a-f][0-9a-f]")
+string(REGEX MATCHALL "${HEX_BYTE}${HEX_BYTE}${HEX_BYTE}${HEX_BYTE}"
+       BYTE_GROUPS "${SPIRV_HEX}")
+set(WORDS "")
+set(COLUMN 0)
+foreach(GROUP ${BYTE_GROUPS})
+  string(SUBSTRING ${GROUP} 0 2 B0)
+  string(SUBSTRING ${GROUP} 2 2 B1)
+  string(SUBSTRING ${GROUP} 4 2 B2)
+  string(SUBSTRING ${GROUP} 6 2 B3)
+  if(COLUMN EQUAL 0)
+    string(APPEND WORDS "   ")
+  endif()
+  string(APPEND WORDS " 0x${B3}${B2}${B1}${B0}u,")
+  math(EXPR COLUMN "(${COLUMN} + 1) % 5")
+  if(COLUMN EQUAL 0)
+    string(APPEND WORDS "\n")
+  endif()
+endforeach()
+if(NOT COLUMN EQUAL 0)
+  string(APPEND WORDS "\n")
+endif()
+
+file(WRITE ${OUTPUT}
+"// generated from ${NAME} by cmake/embedSpirv.cmake, do not edit
+#pragma once
+
+#include \"shaderCode.hpp\"
+
+namespace embeddedShaders {
+
+alignas(16) inline constexpr uint32_t ${SYMBOL}_words[] = {
+${WORDS}};
+
+inline constexpr ShaderCode ${SYMBOL}{
+    \"${NAME}\", ${SYMBOL}_words,
+    sizeof(${SYMBOL}_words) / sizeof(uint32_t)};
+
+} // namespace embeddedShaders
+")
@@ -0,0 +1,65 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec4 fragTint;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
+
+struct GpuObject {
+    vec4 bounds;
+    vec4 uvRect;
+    mat3x2 transform;
+    uint tint;
+    uint textureIndex;
+    uint firstIndex;
+    uint indexCount;
+    int vertexOffset;
+    uint atlasColumns;
+    uint atlasRows;
+    uint baseFrame;
+    uint frameCount;
+    float fps;
+    float startTime;
+    uint loop;
+    float depth;
+    uint padding;
+};
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 viewProj;
+    float time;
+} ubo;
+
+layout(std430, set = 0, binding = 1) readonly buffer Objects {
+    GpuObject objects[];
+};
+
+// shader.vert with everything per object instead of push constants and
+// specialization, so every mesh shares one pipeline
+void main() {
+    // the cull pass stores the object index as firstInstance
+    GpuObject object = objects[gl_InstanceIndex];
+
+    vec2 world = object.transform * vec3(inPosition, 1.0);
+    gl_Position = ubo.viewProj * vec4(world, 0.0, 1.0);
+    // orthographic, w stays 1
+    gl_Position.z = object.depth;
+
+    uint frame = uint(max(ubo.time - object.startTime, 0.0) * object.fps);
+    if (object.loop != 0) {
+        frame = frame % object.frameCount;
+    } else {
+        frame = min(frame, object.frameCount - 1);
+    }
+    uint cell = object.baseFrame + frame;
+
+    vec2 cellSize = 1.0 / vec2(object.atlasColumns, object.atlasRows);
+    vec2 cellOrigin = vec2(cell % object.atlasColumns,
+                           cell / object.atlasColumns);
+    vec2 local = vec2(inTexCoord.x, 1.0 - inTexCoord.y);
+    fragTexCoord = (cellOrigin + local) * cellSize;
+    fragTint = unpackUnorm4x8(object.tint);
+    fragTextureIndex = object.textureIndex;
+}
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec4 fragTint;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTextureIndex;
+
+layout(location = 0) out vec4 outColor;
+
+// keep in sync with maxBindlessTextures in gpuCulling.hpp
+layout(set = 0, binding = 2) uniform sampler2D textures[128];
+
+void main() {
+    outColor = texture(textures[nonuniformEXT(fragTextureIndex)],
+                       fragTexCoord) * fragTint;
+}
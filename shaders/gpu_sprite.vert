@@ -0,0 +1,49 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+
+layout(location = 0) out vec4 fragTint;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureIndex;
+
+struct GpuObject {
+    vec4 bounds;
+    vec4 uvRect;
+    mat3x2 transform;
+    uint tint;
+    uint textureIndex;
+    uint firstIndex;
+    uint indexCount;
+    int vertexOffset;
+    uint atlasColumns;
+    uint atlasRows;
+    uint baseFrame;
+    uint frameCount;
+    float fps;
+    float startTime;
+    uint loop;
+    float depth;
+    uint padding;
+};
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 viewProj;
+    float time;
+} ubo;
+
+layout(std430, set = 0, binding = 1) readonly buffer Objects {
+    GpuObject objects[];
+};
+
+void main() {
+    // the cull pass stores the object index as firstInstance
+    GpuObject object = objects[gl_InstanceIndex];
+
+    vec2 world = object.transform * vec3(inPosition, 1.0);
+    gl_Position = ubo.viewProj * vec4(world, 0.0, 1.0);
+
+    vec2 corner = vec2(inPosition.x + 0.5, 0.5 - inPosition.y);
+    fragTexCoord = mix(object.uvRect.xy, object.uvRect.zw, corner);
+    fragTint = unpackUnorm4x8(object.tint);
+    fragTextureIndex = object.textureIndex;
+}
@@ -6,9 +6,13 @@ layout(location = 1) in vec2 fragTexCoord;
 layout(location = 0) out vec4 outColor;
 layout(binding = 1) uniform sampler2D texSampler;
 
+// same id as in shader.vert
+layout(constant_id = 3) const bool VERTEX_COLOR = false;
+
 void main() {
     //outColor = vec4(fragTexCoord, 0.0, 1.0);
-    vec2 flippedTexCoord = vec2(fragTexCoord.x, 1.0 - fragTexCoord.y);
-    outColor = texture(texSampler, flippedTexCoord);
+    outColor = texture(texSampler, fragTexCoord);
+    if (VERTEX_COLOR) {
+        outColor.rgb *= fragColor;
+    }
 }
-
@@ -8,16 +8,56 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 layout(push_constant) uniform PushConstants {
-    mat4 model;
+    mat3x2 model;
+    uint atlasColumns;
+    uint atlasRows;
+    uint baseFrame;
+    uint frameCount;
+    float fps;
+    float startTime;
+    uint loop;
+    float depth;
 } push;
 
+// specialization constants, keep in sync with meshConstants in
+// animation.hpp. A 0 atlas size reads the size from the push constants.
+layout(constant_id = 0) const uint ATLAS_COLUMNS = 0;
+layout(constant_id = 1) const uint ATLAS_ROWS = 0;
+layout(constant_id = 2) const bool ANIMATED = true;
+layout(constant_id = 3) const bool VERTEX_COLOR = false;
+
 layout(set = 0, binding = 0) uniform UniformBufferObject {
-    mat4 view;
-    mat4 proj;
+    mat4 viewProj;
+    float time;
 } ubo;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * push.model * vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
-    fragTexCoord = inTexCoord;
+    vec2 world = push.model * vec3(inPosition, 1.0);
+    gl_Position = ubo.viewProj * vec4(world, 0.0, 1.0);
+    // orthographic, w stays 1
+    gl_Position.z = push.depth;
+    // unread by shader.frag unless VERTEX_COLOR is set too
+    fragColor = VERTEX_COLOR ? inColor : vec3(1.0);
+
+    uint cell = push.baseFrame;
+    if (ANIMATED) {
+        uint frame = uint(max(ubo.time - push.startTime, 0.0) * push.fps);
+        if (push.loop != 0) {
+            frame = frame % push.frameCount;
+        } else {
+            frame = min(frame, push.frameCount - 1);
+        }
+        cell += frame;
+    }
+
+    // with a specialized atlas size the divide and modulo are by constants
+    uint columns = ATLAS_COLUMNS != 0 ? ATLAS_COLUMNS : push.atlasColumns;
+    uint rows = ATLAS_ROWS != 0 ? ATLAS_ROWS : push.atlasRows;
+
+    // cells count from the top-left of the sheet; the flip used to live in
+    // shader.frag and is applied per cell now
+    vec2 cellSize = 1.0 / vec2(columns, rows);
+    vec2 cellOrigin = vec2(cell % columns, cell / columns);
+    vec2 local = vec2(inTexCoord.x, 1.0 - inTexCoord.y);
+    fragTexCoord = (cellOrigin + local) * cellSize;
 }
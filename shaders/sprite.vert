@@ -0,0 +1,25 @@
+#version 450
+
+layout(location = 0) in vec2 inPosition;
+
+layout(location = 1) in mat3x2 instTransform; // locations 1-3
+layout(location = 4) in vec4 instUvRect;
+layout(location = 5) in vec4 instTint;
+
+layout(location = 0) out vec4 fragTint;
+layout(location = 1) out vec2 fragTexCoord;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 viewProj;
+    float time;
+} ubo;
+
+void main() {
+    vec2 world = instTransform * vec3(inPosition, 1.0);
+    gl_Position = ubo.viewProj * vec4(world, 0.0, 1.0);
+
+    // unit quad spans -0.5..0.5, the top edge samples v0
+    vec2 corner = vec2(inPosition.x + 0.5, 0.5 - inPosition.y);
+    fragTexCoord = mix(instUvRect.xy, instUvRect.zw, corner);
+    fragTint = instTint;
+}
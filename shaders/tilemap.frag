@@ -0,0 +1,42 @@
+#version 450
+
+layout(location = 0) in vec2 fragWorld;
+
+layout(location = 0) out vec4 outColor;
+
+layout(push_constant) uniform PushConstants {
+    vec4 rect;
+    uint atlasColumns;
+    uint atlasRows;
+    float depth;
+} push;
+
+layout(set = 0, binding = 1) uniform sampler2D atlas;
+// R16_UINT, one texel per tile: 0 is empty, n is atlas cell n - 1
+layout(set = 0, binding = 2) uniform usampler2D tileIndex;
+
+void main() {
+    // tiles are centred on integer coordinates
+    vec2 tileSpace = fragWorld + 0.5;
+    vec2 cellSize = 1.0 / vec2(push.atlasColumns, push.atlasRows);
+
+    // gradients of the continuous coordinate, fract() below jumps at every
+    // tile edge; taken before the discard, while the quad is still whole
+    vec2 gradX = dFdx(tileSpace) * cellSize;
+    vec2 gradY = dFdy(tileSpace) * cellSize;
+
+    ivec2 tile = clamp(ivec2(floor(tileSpace)), ivec2(0),
+                       textureSize(tileIndex, 0) - 1);
+    uint type = texelFetch(tileIndex, tile, 0).r;
+    if (type == 0u) {
+        discard;
+    }
+
+    // cells count from the top-left of the atlas, v flipped like shader.vert
+    uint cell = type - 1u;
+    vec2 cellOrigin = vec2(cell % push.atlasColumns, cell / push.atlasColumns);
+    vec2 local = fract(tileSpace);
+    local.y = 1.0 - local.y;
+    outColor = textureGrad(atlas, (cellOrigin + local) * cellSize,
+                           gradX * vec2(1.0, -1.0), gradY * vec2(1.0, -1.0));
+}
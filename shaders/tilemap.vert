@@ -0,0 +1,29 @@
+#version 450
+
+// One quad over the visible part of the map, no vertex buffer; tilemap.frag
+// looks every fragment's tile up in the tile index texture.
+
+layout(location = 0) out vec2 fragWorld;
+
+// keep in sync with TilemapPushConstants in tilemap.hpp
+layout(push_constant) uniform PushConstants {
+    vec4 rect; // world min.xy, max.xy
+    uint atlasColumns;
+    uint atlasRows;
+    float depth;
+} push;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 viewProj;
+    float time;
+} ubo;
+
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0),
+    vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+
+void main() {
+    fragWorld = mix(push.rect.xy, push.rect.zw, corners[gl_VertexIndex]);
+    gl_Position = ubo.viewProj * vec4(fragWorld, 0.0, 1.0);
+    gl_Position.z = push.depth;
+}
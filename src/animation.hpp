@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Sprite-sheet animation. The CPU only records which clip plays and when it
+// started, shader.vert derives the frame from UniformBufferObject::time, so a
+// playing sprite costs no per-frame writes.
+
+// A clip is a run of consecutive cells numbered row-major from the top-left,
+// split into column/row with the same % and / as tilemapMesh::buildChunk.
+struct AnimationClip {
+  std::string name;
+  uint32_t firstFrame = 0;
+  uint32_t frameCount = 1;
+  float fps = 0.0f;
+  bool loop = true;
+};
+
+struct SpriteSheet {
+  std::string texturePath;
+  uint32_t columns = 1;
+  uint32_t rows = 1;
+  std::vector<AnimationClip> clips;
+
+  const AnimationClip *findClip(const std::string &name) const {
+    for (const auto &clip : clips) {
+      if (clip.name == name) {
+        return &clip;
+      }
+    }
+    return nullptr;
+  }
+};
+
+// per-mesh playback state, the defaults draw the whole texture unanimated
+struct SpriteAnimation {
+  uint32_t columns = 1;
+  uint32_t rows = 1;
+  uint32_t baseFrame = 0;
+  uint32_t frameCount = 1;
+  float fps = 0.0f;
+  float startTime = 0.0f;
+  bool loop = true;
+
+  void play(const SpriteSheet &sheet, const AnimationClip &clip, float now) {
+    columns = sheet.columns;
+    rows = sheet.rows;
+    baseFrame = clip.firstFrame;
+    frameCount = clip.frameCount > 0 ? clip.frameCount : 1;
+    fps = clip.fps;
+    loop = clip.loop;
+    startTime = now;
+  }
+
+  void setFrame(const SpriteSheet &sheet, uint32_t frame) {
+    columns = sheet.columns;
+    rows = sheet.rows;
+    baseFrame = frame;
+    frameCount = 1;
+    fps = 0.0f;
+  }
+};
+
+// matches the push_constant block in shader.vert
+struct SpritePushConstants {
+  glm::mat3x2 model; // 2D affine: x axis, y axis, translation
+  uint32_t atlasColumns;
+  uint32_t atlasRows;
+  uint32_t baseFrame;
+  uint32_t frameCount;
+  float fps;
+  float startTime;
+  uint32_t loop;
+  float depth; // gl_Position.z, see layerDepth
+};
+static_assert(sizeof(SpritePushConstants) == 56,
+              "push constant layout must match shader.vert");
+
+// constant_id values of the specialization constants in shader.vert/.frag
+namespace meshConstants {
+constexpr uint32_t atlasColumns = 0; // 0: read from SpritePushConstants
+constexpr uint32_t atlasRows = 1;
+constexpr uint32_t animated = 2; // false: the cell is baseFrame
+constexpr uint32_t vertexColor = 3;
+}; // namespace meshConstants
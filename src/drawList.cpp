@@ -0,0 +1,33 @@
+#include "./drawList.hpp"
+#include <array>
+
+void DrawList::sort() {
+  if (_items.size() < 2) {
+    return;
+  }
+
+  _scratch.resize(_items.size());
+
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    std::array<uint32_t, 256> counts{};
+    for (const auto &item : _items) {
+      counts[(item.key >> shift) & 0xff]++;
+    }
+
+    if (counts[(_items[0].key >> shift) & 0xff] == _items.size()) {
+      continue;
+    }
+
+    uint32_t offset = 0;
+    for (auto &count : counts) {
+      uint32_t bucket = count;
+      count = offset;
+      offset += bucket;
+    }
+
+    for (const auto &item : _items) {
+      _scratch[counts[(item.key >> shift) & 0xff]++] = item;
+    }
+    _items.swap(_scratch);
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 64-bit sort key, most significant field first so sorting by key groups
+// draws by pass, then layer, then pipeline, then texture, then geometry:
+//
+//   pass:1 | layer:8 | pipeline:7 | texture:24 | geometry:24
+//
+// The caller decides the layer order per pass, e.g. inverted for opaque
+// draws so they go front to back.
+namespace drawKey {
+
+constexpr uint32_t passBits = 1;
+constexpr uint32_t layerBits = 8;
+constexpr uint32_t pipelineBits = 7;
+constexpr uint32_t textureBits = 24;
+constexpr uint32_t geometryBits = 24;
+
+constexpr uint32_t opaquePass = 0;
+constexpr uint32_t transparentPass = 1;
+
+constexpr uint64_t make(uint32_t pass, uint32_t layer, uint32_t pipeline,
+                        uint32_t texture, uint32_t geometry) {
+  return (static_cast<uint64_t>(pass & ((1u << passBits) - 1))
+          << (layerBits + pipelineBits + textureBits + geometryBits)) |
+         (static_cast<uint64_t>(layer & ((1u << layerBits) - 1))
+          << (pipelineBits + textureBits + geometryBits)) |
+         (static_cast<uint64_t>(pipeline & ((1u << pipelineBits) - 1))
+          << (textureBits + geometryBits)) |
+         (static_cast<uint64_t>(texture & ((1u << textureBits) - 1))
+          << geometryBits) |
+         static_cast<uint64_t>(geometry & ((1u << geometryBits) - 1));
+}
+
+constexpr uint32_t pass(uint64_t key) {
+  return static_cast<uint32_t>(
+      key >> (layerBits + pipelineBits + textureBits + geometryBits));
+}
+
+constexpr uint32_t pipeline(uint64_t key) {
+  return static_cast<uint32_t>(key >> (textureBits + geometryBits)) &
+         ((1u << pipelineBits) - 1);
+}
+
+}; // namespace drawKey
+
+struct DrawItem {
+  uint64_t key;
+  uint32_t index; // into the caller's draw source, e.g. _meshes
+};
+
+// Per-frame list of visible draws, radix sorted by key before recording.
+class DrawList {
+public:
+  void clear() { _items.clear(); }
+  void add(uint64_t key, uint32_t index) { _items.push_back({key, index}); }
+  uint32_t size() const { return static_cast<uint32_t>(_items.size()); }
+
+  // LSD radix sort, 8 bits per pass; passes where every key has the same
+  // byte are skipped, so unused high fields cost nothing
+  void sort();
+
+  const std::vector<DrawItem> &items() const { return _items; }
+
+private:
+  std::vector<DrawItem> _items;
+  std::vector<DrawItem> _scratch;
+};
@@ -1,6 +1,9 @@
 #include "engine.hpp"
 #include "camera.hpp"
+#include "embeddedShaders.hpp"
+#include "imageLoader.hpp"
 #include "initializers.hpp"
+#include "textureFile.hpp"
 #include "vertexData.hpp"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_events.h>
@@ -12,9 +15,12 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <endian.h>
+#include <filesystem>
 #include <functional>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_float4x4.hpp>
@@ -23,11 +29,11 @@
 #include <glm/trigonometric.hpp>
 #include <glm/vector_relational.hpp>
 #include <immintrin.h>
+#include <limits>
 #include <stdexcept>
+#include <memory>
 #include <variant>
 #include <vulkan/vulkan_core.h>
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
 
 void VulkanEngine::initWindow() {
   SDL_Init(SDL_INIT_VIDEO);
@@ -43,9 +49,13 @@ void VulkanEngine::initVulkan() {
   createInstanceAndPhysicalDeviceAndQueue();
   createSwapchain();
   createImageViews();
+  createDepthResources();
   createDescriptorSetLayout();
+  _pipelineRegistry.init(_device, _physicalDevice, _threadPool,
+                         "pipeline.cache", "pipeline.warmup");
   createGraphicsPipeline();
   createCommandPool();
+  createOverdrawQueries();
   // createVertexBuffer();
   // createIndexBuffer();
   // createTextureImage();
@@ -54,11 +64,34 @@ void VulkanEngine::initVulkan() {
 
   createUniformBuffers();
   createDescriptorPool();
+  createPlaceholderTexture();
+  createSpriteBatchBuffers();
+  if (_gpuCullingSupported) {
+    createGpuCulling();
+  }
+
+  _maxTextureLoadsInFlight = _threadPool.size() * 2;
+  _streamingStart = std::chrono::high_resolution_clock::now();
 
   createMap();
 
   createAllMeshes();
 
+  std::cout << "meshes created in "
+            << std::chrono::duration<double, std::milli>(
+                   std::chrono::high_resolution_clock::now() - _streamingStart)
+                   .count()
+            << " ms, streaming " << _queuedTextures.size() << " "
+            << (_useCookedTextures ? "cooked" : "source") << " textures\n";
+
+  // warmup compiles ran on the pool while the map and meshes were built
+  _pipelineRegistry.finishWarmup();
+  std::cout << "pipelines: " << _pipelineRegistry.createdCount()
+            << " created in " << _pipelineRegistry.createMilliseconds()
+            << " ms ("
+            << (_pipelineRegistry.cacheLoaded() ? "warm" : "cold")
+            << " cache)\n";
+
   // createDescriptorSet();
   createCommandBuffer();
   createSyncObject();
@@ -79,6 +112,12 @@ void VulkanEngine::mainLoop() {
     lastTime = currentTime;
 
     updateMeshes(deltaTime);
+    updateStressSprites(deltaTime);
+    streamTileChunks();
+    updateTileChunks();
+    updateStressTileEdits();
+    updateTextureStreaming();
+    _pipelineRegistry.poll();
 
     while (SDL_PollEvent(&e) != 0) {
       processInput(e);
@@ -103,6 +142,62 @@ void VulkanEngine::mainLoop() {
       closeEngine = true;
     }
 
+    ImGui::Separator();
+    ImGui::SliderInt("sprites", &_stressSpriteCount, 0, 100000);
+    ImGui::SliderInt("tile edits / frame", &_stressTileEdits, 0, 1000);
+    ImGui::Text("%.1f fps", ImGui::GetIO().Framerate);
+    ImGui::Text("draw calls: %u (%u meshes, %u sprite batches)",
+                _drawStats.meshDraws + _drawStats.spriteDraws,
+                _drawStats.meshDraws, _drawStats.spriteDraws);
+    ImGui::Text("sprites: %u", _drawStats.sprites);
+    ImGui::Text("meshes: %u of %zu visible, %u objects uploaded",
+                _meshVisibleCount, _meshes.size(),
+                _drawStats.meshObjectUploads);
+    if (_gpuTilemap) {
+      ImGui::Text("tilemap: gpu, %dx%d index texture (%u draw)",
+                  _worldMap.width(), _worldMap.height(),
+                  _drawStats.tilemapDraws);
+    } else {
+      ImGui::Text("tile chunks: %u visible, %u of %zu built, %zu of %u slots",
+                  _drawStats.tileChunks, _tileChunksBuilt, _tileChunks.size(),
+                  maxTileChunkSlots - _tileChunkFreeSlots.size(),
+                  maxTileChunkSlots);
+    }
+    ImGui::Text("tile edits: %u regions, %.1f KiB uploaded, %zu pending",
+                _drawStats.tileEditRegions, _drawStats.tileEditBytes / 1024.0,
+                _worldMap.dirtyCount());
+    if (!_tileChunkLoaded.empty()) {
+      ImGui::Text("map chunks: %u of %zu loaded", _tileChunksLoaded,
+                  _tileChunkLoaded.size());
+    }
+    if (ImGui::Button("Save map")) {
+      saveMap(_mapPath);
+    }
+    ImGui::Text("binds: %u sorted, %u unsorted", _drawStats.binds,
+                _drawStats.unsortedBinds);
+    ImGui::Text("transforms: %u moving, %u rebuilt", _transforms.activeCount(),
+                _transforms.lastUpdated());
+    ImGui::Text("depth buffer: %s", _depthEnabled ? "on" : "off");
+    ImGui::Text("pipelines: %u ready, %u compiling",
+                _pipelineRegistry.createdCount(),
+                _pipelineRegistry.pendingCount());
+    if (_overdrawQuerySupported) {
+      double pixels = static_cast<double>(_swapchainExtent.width) *
+                      _swapchainExtent.height;
+      ImGui::Text("overdraw: %.2fx (%llu fragments)",
+                  pixels > 0.0 ? _fragmentInvocations / pixels : 0.0,
+                  static_cast<unsigned long long>(_fragmentInvocations));
+    }
+    if (_gpuCullingSupported) {
+      ImGui::Checkbox("GPU culled sprites (indirect)", &_gpuCulling);
+      if (_gpuCulling) {
+        ImGui::Text("gpu visible: %u / %zu", _gpuVisibleCount,
+                    _stressSprites.size());
+      }
+    } else {
+      ImGui::Text("gpu culling: not supported, meshes drawn from the cpu");
+    }
+
     ImGui::End();
     ImGui::Render();
 
@@ -119,18 +214,52 @@ void VulkanEngine::cleanup() {
 
   cleanupSwapChain();
 
-  for (auto &mesh : _meshes) {
-    mesh.cleanup(_device);
+  stopTextureStreaming();
+
+  for (auto &texture : _textures) {
+    texture.cleanup(_device);
   }
+  _textures.clear();
+  _placeholderTexture.cleanup(_device);
+
   _meshes.clear();
+  destroyMeshGeometry();
+  _tileChunks.clear();
+  destroyTileChunkPool();
+  for (uint32_t i = 0; i < _tileEditStaging.size(); i++) {
+    destroyTileEditStaging(i);
+  }
+  destroyGpuTilemap();
+
+  // the registry owns every graphics pipeline
+  _pipelineRegistry.save();
+  _pipelineRegistry.destroy();
+  _graphicsPipeline = VK_NULL_HANDLE;
+  if (_overdrawQueryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(_device, _overdrawQueryPool, nullptr);
+    _overdrawQueryPool = VK_NULL_HANDLE;
+  }
 
-  if (_graphicsPipeline != VK_NULL_HANDLE) {
-    vkDestroyPipeline(_device, _graphicsPipeline, nullptr);
-    _graphicsPipeline = VK_NULL_HANDLE;
+  destroyGpuCulling();
+
+  for (uint32_t i = 0; i < _spriteInstanceBuffers.size(); i++) {
+    destroySpriteInstanceBuffer(i);
+  }
+  if (_spriteQuadVertexBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, _spriteQuadVertexBuffer, nullptr);
+    _spriteQuadVertexBuffer = VK_NULL_HANDLE;
   }
-  if (_pipelineLayout != VK_NULL_HANDLE) {
-    vkDestroyPipelineLayout(_device, _pipelineLayout, nullptr);
-    _pipelineLayout = VK_NULL_HANDLE;
+  if (_spriteQuadVertexBufferMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, _spriteQuadVertexBufferMemory, nullptr);
+    _spriteQuadVertexBufferMemory = VK_NULL_HANDLE;
+  }
+  if (_spriteQuadIndexBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, _spriteQuadIndexBuffer, nullptr);
+    _spriteQuadIndexBuffer = VK_NULL_HANDLE;
+  }
+  if (_spriteQuadIndexBufferMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, _spriteQuadIndexBufferMemory, nullptr);
+    _spriteQuadIndexBufferMemory = VK_NULL_HANDLE;
   }
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -148,10 +277,11 @@ void VulkanEngine::cleanup() {
     vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
     _descriptorPool = VK_NULL_HANDLE;
   }
-  if (_descriptorSetLayout != VK_NULL_HANDLE) {
-    vkDestroyDescriptorSetLayout(_device, _descriptorSetLayout, nullptr);
-    _descriptorSetLayout = VK_NULL_HANDLE;
-  }
+  _layoutCache.destroy();
+  _pipelineLayout = VK_NULL_HANDLE;
+  _descriptorSetLayout = VK_NULL_HANDLE;
+  _spritePipelineLayout = VK_NULL_HANDLE;
+  _tilemapPipelineLayout = VK_NULL_HANDLE;
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     if (_imageAvailableSemaphores[i] != VK_NULL_HANDLE) {
@@ -235,6 +365,25 @@ void VulkanEngine::createInstanceAndPhysicalDeviceAndQueue() {
   VkPhysicalDeviceFeatures deviceFeatures{};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+  VkPhysicalDeviceFeatures optionalFeatures{};
+  optionalFeatures.textureCompressionBC = VK_TRUE;
+
+  // GPU culling: indirect draws and a bindless texture array
+  VkPhysicalDeviceFeatures indirectFeatures{};
+  indirectFeatures.multiDrawIndirect = VK_TRUE;
+  indirectFeatures.drawIndirectFirstInstance = VK_TRUE;
+
+  VkPhysicalDeviceVulkan12Features indirectFeatures12{
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  indirectFeatures12.drawIndirectCount = VK_TRUE;
+  indirectFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+  indirectFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+  indirectFeatures12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+
+  // overdraw counter, fragment shader invocations per frame
+  VkPhysicalDeviceFeatures statisticsFeatures{};
+  statisticsFeatures.pipelineStatisticsQuery = VK_TRUE;
+
   // features13.pNext = &features12;
 
   vkb::PhysicalDeviceSelector selector{final_instance};
@@ -251,6 +400,19 @@ void VulkanEngine::createInstanceAndPhysicalDeviceAndQueue() {
     throw std::runtime_error("failed to select physical device");
   }
 
+  _textureCompressionBC =
+      physicalDeviceReturn.enable_features_if_present(optionalFeatures);
+  _gpuCullingSupported =
+      physicalDeviceReturn.properties.limits.maxPerStageDescriptorSamplers >=
+          maxBindlessTextures &&
+      physicalDeviceReturn.enable_features_if_present(indirectFeatures) &&
+      physicalDeviceReturn.enable_extension_features_if_present(
+          indirectFeatures12);
+  _validateGpuCulling = std::getenv("VK2D_VALIDATE_CULL") != nullptr;
+  _useCookedTextures = std::getenv("VK2D_SOURCE_TEXTURES") == nullptr;
+  _overdrawQuerySupported =
+      physicalDeviceReturn.enable_features_if_present(statisticsFeatures);
+
   vkb::DeviceBuilder deviceBuilder{physicalDeviceReturn};
   vkb::Device vkbDevice = deviceBuilder.build().value();
 
@@ -261,6 +423,12 @@ void VulkanEngine::createInstanceAndPhysicalDeviceAndQueue() {
   _presentQueue = vkbDevice.get_queue(vkb::QueueType::present).value();
   _graphicsQueueFamily =
       vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
+
+  _depthEnabled = std::getenv("VK2D_NO_DEPTH") == nullptr;
+  _gpuTilemap = std::getenv("VK2D_TILEMAP_MESH") == nullptr;
+  if (_depthEnabled) {
+    _depthFormat = findDepthFormat();
+  }
 }
 
 void VulkanEngine::DestroyDebugUtilsMessengerEXT(
@@ -303,38 +471,46 @@ void VulkanEngine::createSwapchain() {
 }
 
 void VulkanEngine::createGraphicsPipeline() {
+  // built up front, it is what every other mesh pipeline falls back to
+  _graphicsPipeline = _pipelineRegistry.get(meshPipelineDesc(false, {}));
 
-  auto vertShaderCode = readFile("../shaders/shader.vert.spv");
-  auto fragShaderCode = readFile("../shaders/shader.frag.spv");
-
-  VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-  VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+  // variant 0 takes everything from the push constants and draws any mesh
+  MeshVariant generic;
+  generic.opaque = _pipelineRegistry.declare(meshPipelineDesc(false, {}));
+  generic.transparent = _pipelineRegistry.declare(meshPipelineDesc(true, {}));
+  _meshVariants.assign(1, generic);
+  _meshVariantIndex.clear();
 
-  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-  vertShaderStageInfo.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  vertShaderStageInfo.module = vertShaderModule;
-  vertShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-  fragShaderStageInfo.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  fragShaderStageInfo.module = fragShaderModule;
-  fragShaderStageInfo.pName = "main";
-
-  VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo,
-                                                    fragShaderStageInfo};
-
-  std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT,
-                                               VK_DYNAMIC_STATE_SCISSOR};
+  auto attributeDescriptions = vertexData::Vertex::getAttributeDescriptions();
 
-  VkPipelineDynamicStateCreateInfo dynamicState{};
-  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-  dynamicState.pDynamicStates = dynamicStates.data();
+  // sprites read only the position of the shared quad, the rest per
+  // instance; the instance attributes shadow the quad's color and uv
+  std::array<VkVertexInputBindingDescription, 2> spriteBindings = {
+      vertexData::Vertex::getBindingDescription(),
+      SpriteInstance::getBindingDescription()};
+  auto instanceAttributes = SpriteInstance::getAttributeDescriptions();
+  std::vector<VkVertexInputAttributeDescription> spriteAttributes(
+      attributeDescriptions.begin(), attributeDescriptions.end());
+  spriteAttributes.insert(spriteAttributes.end(), instanceAttributes.begin(),
+                          instanceAttributes.end());
+
+  VkPipelineVertexInputStateCreateInfo spriteInputInfo{};
+  spriteInputInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  spriteInputInfo.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(spriteBindings.size());
+  spriteInputInfo.pVertexBindingDescriptions = spriteBindings.data();
+  spriteInputInfo.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(spriteAttributes.size());
+  spriteInputInfo.pVertexAttributeDescriptions = spriteAttributes.data();
+
+  _spritePipeline = _pipelineRegistry.declare(
+      pipelineDesc(embeddedShaders::sprite_vert, embeddedShaders::sprite_frag,
+                   spriteInputInfo, true));
+}
 
+PipelineDesc VulkanEngine::meshPipelineDesc(
+    bool alphaBlend, std::vector<PipelineDesc::Constant> constants) {
   auto bindingDescription = vertexData::Vertex::getBindingDescription();
   auto attributeDescriptions = vertexData::Vertex::getAttributeDescriptions();
 
@@ -347,151 +523,112 @@ void VulkanEngine::createGraphicsPipeline() {
   vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
   vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
-  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-  inputAssembly.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
+  PipelineDesc desc =
+      pipelineDesc(embeddedShaders::shader_vert, embeddedShaders::shader_frag,
+                   vertexInputInfo, alphaBlend);
+  desc.constants = std::move(constants);
+  return desc;
+}
 
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float)_swapchainExtent.width;
-  viewport.height = (float)_swapchainExtent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
+uint32_t VulkanEngine::meshVariant(const Mesh &mesh) {
+  const SpriteAnimation &animation = mesh.animation;
+  bool animated = animation.frameCount > 1;
+  uint64_t id = (static_cast<uint64_t>(animation.columns) << 33) |
+                (static_cast<uint64_t>(animation.rows) << 1) |
+                (animated ? 1u : 0u);
 
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = _swapchainExtent;
+  auto found = _meshVariantIndex.find(id);
+  if (found != _meshVariantIndex.end()) {
+    return found->second;
+  }
+  // the draw key holds the variant and the transparent bit in 7 bits
+  if (_meshVariants.size() >= maxMeshVariants) {
+    return 0;
+  }
+
+  std::vector<PipelineDesc::Constant> constants = {
+      {meshConstants::atlasColumns, animation.columns},
+      {meshConstants::atlasRows, animation.rows},
+      {meshConstants::animated, animated ? 1u : 0u}};
+
+  MeshVariant variant;
+  variant.opaque =
+      _pipelineRegistry.declare(meshPipelineDesc(false, constants));
+  variant.transparent =
+      _pipelineRegistry.declare(meshPipelineDesc(true, constants));
+
+  uint32_t index = static_cast<uint32_t>(_meshVariants.size());
+  _meshVariants.push_back(variant);
+  _meshVariantIndex.emplace(id, index);
+  return index;
+}
 
-  VkPipelineViewportStateCreateInfo viewportState{};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
-  viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
-
-  VkPipelineRasterizationStateCreateInfo rasterizer{};
-  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterizer.depthClampEnable = VK_FALSE;
-  rasterizer.rasterizerDiscardEnable = VK_FALSE;
-  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-  rasterizer.lineWidth = 1.0f;
-  rasterizer.depthBiasEnable = VK_FALSE;
-  rasterizer.depthBiasConstantFactor = 0.0f;
-  rasterizer.depthBiasClamp = 0.0f;
-  rasterizer.depthBiasSlopeFactor = 0.0f;
-  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-
-  VkPipelineMultisampleStateCreateInfo multisampling{};
-  multisampling.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-  multisampling.minSampleShading = 1.0f;
-  multisampling.pSampleMask = nullptr;
-  multisampling.alphaToCoverageEnable = VK_FALSE;
-  multisampling.alphaToOneEnable = VK_FALSE;
-
-  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-  colorBlendAttachment.colorWriteMask =
-      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  colorBlendAttachment.blendEnable = VK_FALSE;
-  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-  colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-  VkPipelineColorBlendStateCreateInfo colorBlending{};
-  colorBlending.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  colorBlending.logicOpEnable = VK_FALSE;
-  colorBlending.logicOp = VK_LOGIC_OP_COPY;
-  colorBlending.attachmentCount = 1;
-  colorBlending.pAttachments = &colorBlendAttachment;
-  colorBlending.blendConstants[0] = 0.0f;
-  colorBlending.blendConstants[1] = 0.0f;
-  colorBlending.blendConstants[2] = 0.0f;
-  colorBlending.blendConstants[3] = 0.0f;
-
-  VkPushConstantRange pushConstantRange{};
-  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  pushConstantRange.offset = 0;
-  pushConstantRange.size = sizeof(glm::mat4);
-
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &_descriptorSetLayout;
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-  if (vkCreatePipelineLayout(_device, &pipelineLayoutInfo, nullptr,
-                             &_pipelineLayout) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create pipeline layout");
-  }
-
-  VkFormat colorFormat = VK_FORMAT_B8G8R8A8_SRGB;
-
-  VkPipelineRenderingCreateInfo renderingCreateInfo{};
-  renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
-  renderingCreateInfo.colorAttachmentCount = 1;
-  renderingCreateInfo.pColorAttachmentFormats = &colorFormat;
-  renderingCreateInfo.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
-  renderingCreateInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
-
-  VkGraphicsPipelineCreateInfo pipelineInfo{};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.stageCount = 2;
-  pipelineInfo.pStages = shaderStages;
-  pipelineInfo.pVertexInputState = &vertexInputInfo;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterizer;
-  pipelineInfo.pMultisampleState = &multisampling;
-  pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = &dynamicState;
-  pipelineInfo.layout = _pipelineLayout;
-  pipelineInfo.renderPass = VK_NULL_HANDLE;
-  pipelineInfo.subpass = 0;
-
-  pipelineInfo.pNext = &renderingCreateInfo;
-
-  vkCreateGraphicsPipelines(_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
-                            &_graphicsPipeline);
-
-  vkDestroyShaderModule(_device, fragShaderModule, nullptr);
-  vkDestroyShaderModule(_device, vertShaderModule, nullptr);
-}
-
-std::vector<char> VulkanEngine::readFile(const std::string &filename) {
-  std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-  if (!file.is_open()) {
-    throw std::runtime_error("failed to open file");
-  }
-
-  size_t fileSize = (size_t)file.tellg();
-  std::vector<char> buffer(fileSize);
-
-  file.seekg(0);
-  file.read(buffer.data(), fileSize);
+VkPipeline VulkanEngine::meshPipeline(uint32_t variant, bool transparent) {
+  // until a specialized variant is compiled the generic one draws it, and
+  // until the blended generic one is, transparent meshes draw opaque
+  for (uint32_t index : {variant, 0u}) {
+    const MeshVariant &candidate = _meshVariants[index];
+    VkPipeline pipeline = _pipelineRegistry.request(
+        transparent ? candidate.transparent : candidate.opaque);
+    if (pipeline != VK_NULL_HANDLE) {
+      return pipeline;
+    }
+  }
+  return _graphicsPipeline;
+}
 
-  file.close();
+uint64_t VulkanEngine::meshDrawKey(const Mesh &mesh, uint32_t geometry) {
+  // opaque meshes go front to back so covered fragments fail the early
+  // depth test; without a depth buffer everything falls back to painter's
+  // order in the transparent pass. GPU culling keeps every mesh in its
+  // command slot, so this is the draw order; every mesh draws with the same
+  // pipeline and bindless textures there, so only pass and layer matter.
+  bool opaque = _depthEnabled && !mesh.transparent;
+  uint32_t pass = opaque ? drawKey::opaquePass : drawKey::transparentPass;
+  uint32_t layer = opaque ? 255u - mesh.layer : mesh.layer;
+  if (_gpuCullingSupported) {
+    return drawKey::make(pass, layer, 0, 0, geometry);
+  }
+  // the CPU loop binds per run, texture 0 is the placeholder
+  uint32_t pipeline = meshVariant(mesh) * 2 + (mesh.transparent ? 1 : 0);
+  uint32_t texture =
+      _textures[mesh.textureId].resident ? mesh.textureId + 1 : 0;
+  return drawKey::make(pass, layer, pipeline, texture, geometry);
+}
 
-  return buffer;
+PipelineDesc VulkanEngine::pipelineDesc(
+    const ShaderCode &vert, const ShaderCode &frag,
+    const VkPipelineVertexInputStateCreateInfo &vertexInputInfo,
+    bool alphaBlend) {
+  PipelineDesc desc;
+  desc.vert = vert;
+  desc.frag = frag;
+  desc.bindings.assign(vertexInputInfo.pVertexBindingDescriptions,
+                       vertexInputInfo.pVertexBindingDescriptions +
+                           vertexInputInfo.vertexBindingDescriptionCount);
+  // the input state lists what the buffers offer, the shader picks
+  desc.attributes = reflection::selectAttributes(
+      _layoutCache.reflect(vert),
+      std::vector<VkVertexInputAttributeDescription>(
+          vertexInputInfo.pVertexAttributeDescriptions,
+          vertexInputInfo.pVertexAttributeDescriptions +
+              vertexInputInfo.vertexAttributeDescriptionCount));
+  desc.alphaBlend = alphaBlend;
+  // blended draws are tested against depth but leave it untouched, so they
+  // can only go back to front after the opaque pass
+  desc.depthTest = _depthEnabled;
+  desc.depthWrite = _depthEnabled && !alphaBlend;
+  desc.colorFormat = _swapchainImageFormat;
+  desc.depthFormat = _depthFormat;
+  desc.layout = _layoutCache.get({vert, frag}).layout;
+  return desc;
 }
 
-VkShaderModule VulkanEngine::createShaderModule(const std::vector<char> &code) {
+VkShaderModule VulkanEngine::createShaderModule(const ShaderCode &code) {
   VkShaderModuleCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
   createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+  createInfo.pCode = code.words;
 
   VkShaderModule shaderModule;
   if (vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule) !=
@@ -550,6 +687,25 @@ void VulkanEngine::recordCommandBuffer(VkCommandBuffer commandBuffer,
   // oldLayout, VkImageLayout newLayout, VkCommandPool commandPool, VkDevice
   // device, VkQueue graphicsQueue)
 
+  _drawStats = {};
+
+  // compute work and copies have to be recorded outside of dynamic rendering
+  flushTileEdits(commandBuffer, currentFrame);
+  if (_gpuCullingSupported) {
+    flushMeshObjects(commandBuffer, currentFrame);
+    cullObjects(commandBuffer, currentFrame);
+  }
+
+  if (_overdrawQueryPool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, _overdrawQueryPool, currentFrame, 1);
+  }
+
+  if (_depthEnabled) {
+    vkinit::transitionImage(commandBuffer, _depthImage,
+                            VK_IMAGE_LAYOUT_UNDEFINED,
+                            VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+  }
+
   vkinit::transitionImageLayout(_swapchainImages[imageIndex],
                                 VK_IMAGE_LAYOUT_UNDEFINED,
                                 VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
@@ -573,6 +729,8 @@ void VulkanEngine::recordCommandBuffer(VkCommandBuffer commandBuffer,
 void VulkanEngine::drawFrame() {
   vkWaitForFences(_device, 1, &_inFlightFences[currentFrame], VK_TRUE,
                   UINT64_MAX);
+  readGpuCullResult(currentFrame);
+  readOverdrawQuery(currentFrame);
 
   uint32_t imageIndex;
   VkResult result = vkAcquireNextImageKHR(
@@ -695,10 +853,23 @@ void VulkanEngine::drawGeometry(VkCommandBuffer commandBuffer,
   renderingInfo.pDepthAttachment = nullptr;
   renderingInfo.pStencilAttachment = nullptr;
 
+  VkRenderingAttachmentInfoKHR depthAttachmentInfo{};
+  if (_depthEnabled) {
+    depthAttachmentInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depthAttachmentInfo.imageView = _depthImageView;
+    depthAttachmentInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+    depthAttachmentInfo.resolveMode = VK_RESOLVE_MODE_NONE;
+    depthAttachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachmentInfo.clearValue.depthStencil = {1.0f, 0};
+    renderingInfo.pDepthAttachment = &depthAttachmentInfo;
+  }
+
   vkCmdBeginRendering(commandBuffer, &renderingInfo);
 
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                    _graphicsPipeline);
+  if (_overdrawQueryPool != VK_NULL_HANDLE) {
+    vkCmdBeginQuery(commandBuffer, _overdrawQueryPool, currentFrame, 0);
+  }
 
   VkViewport viewport{};
   viewport.x = 0.0f;
@@ -714,24 +885,30 @@ void VulkanEngine::drawGeometry(VkCommandBuffer commandBuffer,
   scissor.extent = _swapchainExtent;
   vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-  for (const auto &mesh : _meshes) {
-
-    updateUniformBuffer(currentFrame);
-    vkCmdPushConstants(commandBuffer, _pipelineLayout,
-                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4),
-                       &mesh.transform);
-    VkBuffer vertexBuffers[] = {mesh.vertexBuffer};
-    VkDeviceSize offsets[] = {0};
+  updateUniformBuffer(currentFrame);
 
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+  // the map is the back layer: last of the opaque pass, or first of the
+  // painter's order when everything is blended
+  if (_gpuCullingSupported) {
+    drawGpuMeshes(commandBuffer, currentFrame, false);
+  } else {
+    sortMeshDraws(cameraRect());
+    drawMeshes(commandBuffer, drawKey::opaquePass);
+  }
+  drawTileChunks(commandBuffer, cameraRect());
+  drawGpuTilemap(commandBuffer, currentFrame);
+  if (_gpuCullingSupported) {
+    drawGpuMeshes(commandBuffer, currentFrame, true);
+  } else {
+    drawMeshes(commandBuffer, drawKey::transparentPass);
+  }
 
-    vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0,
-                         VK_INDEX_TYPE_UINT16);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            _pipelineLayout, 0, 1, &mesh.descriptorSet, 0,
-                            nullptr);
+  drawSprites(commandBuffer, currentFrame);
+  drawGpuObjects(commandBuffer, currentFrame);
 
-    vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0);
+  if (_overdrawQueryPool != VK_NULL_HANDLE) {
+    vkCmdEndQuery(commandBuffer, _overdrawQueryPool, currentFrame);
+    _overdrawQueryIssued[currentFrame] = true;
   }
 
   ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
@@ -739,205 +916,1123 @@ void VulkanEngine::drawGeometry(VkCommandBuffer commandBuffer,
   vkCmdEndRendering(commandBuffer);
 }
 
-void VulkanEngine::recreateSwapChain() {
-  int width = 0, height = 0;
-
-  SDL_GetWindowSize(_window, &width, &height);
-  if (width <= 0 || height <= 0) {
-    _resized = true;
+void VulkanEngine::drawSprites(VkCommandBuffer commandBuffer,
+                               uint32_t currentFrame) {
+  uint32_t spriteCount = _spriteBatch.size();
+  if (spriteCount == 0) {
+    return;
   }
 
-  vkDeviceWaitIdle(_device);
-
-  cleanupSwapChain();
-
-  createSwapchain();
-  // createImageViews();
-}
-
-void VulkanEngine::cleanupSwapChain() {
-  for (auto imageView : _swapchainImageViews) {
-    vkDestroyImageView(_device, imageView, nullptr);
+  // no fallback shares the instanced layout, sprites wait for their pipeline
+  VkPipeline pipeline = _pipelineRegistry.request(_spritePipeline);
+  if (pipeline == VK_NULL_HANDLE) {
+    return;
   }
 
-  _swapchainImageViews.clear();
+  // this frame's fence has been waited on, its instance buffer is free
+  reserveSpriteInstances(currentFrame, spriteCount);
+  _spriteBatch.build(
+      static_cast<SpriteInstance *>(_spriteInstanceBuffersMapped[currentFrame]),
+      static_cast<uint32_t>(_textures.size()));
 
-  vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipeline);
+
+  VkBuffer vertexBuffers[] = {_spriteQuadVertexBuffer,
+                              _spriteInstanceBuffers[currentFrame]};
+  VkDeviceSize offsets[] = {0, 0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, _spriteQuadIndexBuffer, 0,
+                       _spriteQuadIndexType);
+  // one texture bind per group, or per run of the unsorted sprites
+  _drawStats.binds += 3 + static_cast<uint32_t>(_spriteBatch.groups().size());
+  _drawStats.unsortedBinds += 3 + _spriteBatch.unsortedRuns();
+
+  uint32_t quadIndexCount =
+      static_cast<uint32_t>(vertexData::indices.size());
+  for (const auto &group : _spriteBatch.groups()) {
+    VkDescriptorSet descriptorSet = textureDescriptorSet(group.textureId);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            _spritePipelineLayout, 0, 1, &descriptorSet, 0,
+                            nullptr);
+    vkCmdDrawIndexed(commandBuffer, quadIndexCount, group.instanceCount, 0, 0,
+                     group.firstInstance);
+    _drawStats.spriteDraws++;
+  }
+  _drawStats.sprites = spriteCount;
 }
 
-void VulkanEngine::createVertexBuffer() {
-
-  VkDeviceSize bufferSize =
-      sizeof(vertexData::vertices[0]) * vertexData::vertices.size();
+VkDescriptorSet VulkanEngine::textureDescriptorSet(uint32_t textureId) const {
+  const Texture &texture = _textures[textureId];
+  return texture.resident ? texture.descriptorSet
+                          : _placeholderTexture.descriptorSet;
+}
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
+void VulkanEngine::createGpuCulling() {
+  // the padding after orderedFirst is C++ side only
+  const auto &cullLayout = _layoutCache.get({embeddedShaders::cull_comp});
+  if (cullLayout.pushConstants.size != offsetof(CullPushConstants, padding)) {
+    throw std::runtime_error("cull.comp push constants do not match "
+                             "CullPushConstants");
+  }
+  _cullSetLayout = cullLayout.setLayouts[0];
+  _cullPipelineLayout = cullLayout.layout;
+
+  // the texture array makes this a bindless layout, see LayoutCache;
+  // gpu_mesh.vert declares the same bindings and gets the same layout
+  const auto &drawLayout = _layoutCache.get(
+      {embeddedShaders::gpu_sprite_vert, embeddedShaders::gpu_sprite_frag});
+  _bindlessSetLayout = drawLayout.setLayouts[0];
+  _bindlessPipelineLayout = drawLayout.layout;
+  if (_layoutCache.get({embeddedShaders::gpu_mesh_vert,
+                        embeddedShaders::gpu_sprite_frag})
+          .layout != _bindlessPipelineLayout) {
+    throw std::runtime_error("gpu_mesh.vert bindings do not match "
+                             "gpu_sprite.vert");
+  }
 
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
+  VkShaderModule cullShaderModule =
+      createShaderModule(embeddedShaders::cull_comp);
 
-  void *data;
-  vkMapMemory(_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, vertexData::vertices.data(), (size_t)bufferSize);
-  vkUnmapMemory(_device, stagingBufferMemory);
+  VkComputePipelineCreateInfo computeInfo{};
+  computeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  computeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  computeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  computeInfo.stage.module = cullShaderModule;
+  computeInfo.stage.pName = "main";
+  computeInfo.layout = _cullPipelineLayout;
 
-  createBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _vertexBuffer, _vertexBufferMemory);
+  VkResult result =
+      vkCreateComputePipelines(_device, _pipelineRegistry.cache(), 1,
+                               &computeInfo, nullptr, &_cullPipeline);
+  vkDestroyShaderModule(_device, cullShaderModule, nullptr);
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create cull pipeline");
+  }
 
-  copyBuffer(stagingBuffer, _vertexBuffer, bufferSize);
+  auto bindingDescription = vertexData::Vertex::getBindingDescription();
+  auto attributeDescriptions = vertexData::Vertex::getAttributeDescriptions();
 
-  vkDestroyBuffer(_device, stagingBuffer, nullptr);
-  vkFreeMemory(_device, stagingBufferMemory, nullptr);
-}
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  vertexInputInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+  vertexInputInfo.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(attributeDescriptions.size());
+  vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
-uint32_t VulkanEngine::findMemoryType(uint32_t typeFilter,
-                                      VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &memProperties);
+  _gpuSpritePipeline = _pipelineRegistry.declare(pipelineDesc(
+      embeddedShaders::gpu_sprite_vert, embeddedShaders::gpu_sprite_frag,
+      vertexInputInfo, true));
+  _gpuMeshPipeline = _pipelineRegistry.get(pipelineDesc(
+      embeddedShaders::gpu_mesh_vert, embeddedShaders::gpu_sprite_frag,
+      vertexInputInfo, false));
+  _gpuMeshBlendPipeline = _pipelineRegistry.get(pipelineDesc(
+      embeddedShaders::gpu_mesh_vert, embeddedShaders::gpu_sprite_frag,
+      vertexInputInfo, true));
+
+  _gpuCullFrames.resize(MAX_FRAMES_IN_FLIGHT);
+  for (uint32_t i = 0; i < _gpuCullFrames.size(); i++) {
+    createCullBatch(_gpuCullFrames[i].sprites, i);
+    createCullBatch(_gpuCullFrames[i].meshes, i);
+  }
 
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags &
-                                    properties) == properties) {
-      return i;
+  writeBindlessTexture(0, _placeholderTexture);
+  for (uint32_t i = 0; i < _textures.size(); i++) {
+    if (_textures[i].resident && i + 1 < maxBindlessTextures) {
+      writeBindlessTexture(i + 1, _textures[i]);
     }
   }
-  throw std::runtime_error("failed to find suitable memory type");
 }
 
-void VulkanEngine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
-                                VkMemoryPropertyFlags properties,
-                                VkBuffer &buffer,
-                                VkDeviceMemory &bufferMemory) {
-
-  VkBufferCreateInfo bufferInfo{};
-  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferInfo.size = size;
-  bufferInfo.usage = usage;
-  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+void VulkanEngine::destroyGpuCulling() {
+  for (auto &frame : _gpuCullFrames) {
+    destroyGpuObjectBuffer(frame);
+    destroyMeshStaging(frame);
+    destroyCullBatch(frame.sprites);
+    destroyCullBatch(frame.meshes);
+  }
+  _gpuCullFrames.clear();
+  destroyMeshObjectBuffer();
 
-  if (vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create buffer");
+  if (_cullPipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(_device, _cullPipeline, nullptr);
+    _cullPipeline = VK_NULL_HANDLE;
   }
+  // the registry owns the graphics pipelines, _layoutCache the layouts
+  _gpuMeshPipeline = VK_NULL_HANDLE;
+  _gpuMeshBlendPipeline = VK_NULL_HANDLE;
+  _bindlessPipelineLayout = VK_NULL_HANDLE;
+  _cullPipelineLayout = VK_NULL_HANDLE;
+  _bindlessSetLayout = VK_NULL_HANDLE;
+  _cullSetLayout = VK_NULL_HANDLE;
+}
 
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(_device, buffer, &memRequirements);
+void VulkanEngine::createCullBatch(GpuCullBatch &batch, uint32_t frame) {
+  createBuffer(sizeof(GpuCullCounts),
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               batch.countBuffer, batch.countBufferMemory);
+  vkMapMemory(_device, batch.countBufferMemory, 0, sizeof(GpuCullCounts), 0,
+              reinterpret_cast<void **>(&batch.countMapped));
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex =
-      findMemoryType(memRequirements.memoryTypeBits, properties);
+  std::array<VkDescriptorSetLayout, 2> layouts = {_cullSetLayout,
+                                                  _bindlessSetLayout};
+  std::array<VkDescriptorSet, 2> sets{};
 
-  if (vkAllocateMemory(_device, &allocInfo, nullptr, &bufferMemory) !=
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = _descriptorPool;
+  allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+  allocInfo.pSetLayouts = layouts.data();
+
+  if (vkAllocateDescriptorSets(_device, &allocInfo, sets.data()) !=
       VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate vertex buffer memory");
+    throw std::runtime_error("failed to allocate gpu culling descriptor sets");
   }
+  batch.cullSet = sets[0];
+  batch.drawSet = sets[1];
+
+  VkDescriptorBufferInfo countInfo{};
+  countInfo.buffer = batch.countBuffer;
+  countInfo.range = VK_WHOLE_SIZE;
+
+  VkDescriptorBufferInfo uboInfo{};
+  uboInfo.buffer = _uniformBuffers[frame];
+  uboInfo.offset = 0;
+  uboInfo.range = sizeof(UniformBufferObject);
+
+  std::array<VkWriteDescriptorSet, 2> writes{};
+  writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[0].dstSet = batch.cullSet;
+  writes[0].dstBinding = 2;
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  writes[0].descriptorCount = 1;
+  writes[0].pBufferInfo = &countInfo;
+  writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[1].dstSet = batch.drawSet;
+  writes[1].dstBinding = 0;
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  writes[1].descriptorCount = 1;
+  writes[1].pBufferInfo = &uboInfo;
+  vkUpdateDescriptorSets(_device, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
+}
 
-  vkBindBufferMemory(_device, buffer, bufferMemory, 0);
+void VulkanEngine::destroyCullBatch(GpuCullBatch &batch) {
+  if (batch.drawBufferMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, batch.drawBufferMemory, nullptr);
+    batch.drawBufferMemory = VK_NULL_HANDLE;
+  }
+  if (batch.drawBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, batch.drawBuffer, nullptr);
+    batch.drawBuffer = VK_NULL_HANDLE;
+  }
+  if (batch.countBufferMemory != VK_NULL_HANDLE) {
+    vkUnmapMemory(_device, batch.countBufferMemory);
+    vkFreeMemory(_device, batch.countBufferMemory, nullptr);
+    batch.countBufferMemory = VK_NULL_HANDLE;
+  }
+  if (batch.countBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, batch.countBuffer, nullptr);
+    batch.countBuffer = VK_NULL_HANDLE;
+  }
+  // the sets go with _descriptorPool
+  batch.countMapped = nullptr;
+  batch.capacity = 0;
 }
 
-void VulkanEngine::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
-                              VkDeviceSize size) {
+void VulkanEngine::reserveCullDraws(GpuCullBatch &batch, uint32_t count) {
+  if (batch.capacity >= count) {
+    return;
+  }
 
-  VkCommandBuffer commandBuffer =
-      vkinit::beginSingleTimeCommands(_commandPool, _device);
+  // only called for the frame being recorded, its last use has finished
+  uint32_t capacity = std::max({count, batch.capacity * 2, 1024u});
+  if (batch.drawBufferMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, batch.drawBufferMemory, nullptr);
+    vkDestroyBuffer(_device, batch.drawBuffer, nullptr);
+  }
 
-  VkBufferCopy copyRegion{};
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+  createBuffer(sizeof(VkDrawIndexedIndirectCommand) * capacity,
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, batch.drawBuffer,
+               batch.drawBufferMemory);
+  batch.capacity = capacity;
+
+  VkDescriptorBufferInfo drawInfo{};
+  drawInfo.buffer = batch.drawBuffer;
+  drawInfo.range = VK_WHOLE_SIZE;
+
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = batch.cullSet;
+  write.dstBinding = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.descriptorCount = 1;
+  write.pBufferInfo = &drawInfo;
+  vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+}
 
-  vkinit::endSingleTimeCommands(commandBuffer, _graphicsQueue, _device,
-                                _commandPool);
+void VulkanEngine::writeCullObjects(GpuCullBatch &batch,
+                                    VkBuffer objectBuffer) {
+  VkDescriptorBufferInfo objectInfo{};
+  objectInfo.buffer = objectBuffer;
+  objectInfo.range = VK_WHOLE_SIZE;
+
+  // read by the cull pass and, through firstInstance, the vertex shader
+  std::array<VkWriteDescriptorSet, 2> writes{};
+  writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  writes[0].dstSet = batch.cullSet;
+  writes[0].dstBinding = 0;
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  writes[0].descriptorCount = 1;
+  writes[0].pBufferInfo = &objectInfo;
+  writes[1] = writes[0];
+  writes[1].dstSet = batch.drawSet;
+  writes[1].dstBinding = 1;
+  vkUpdateDescriptorSets(_device, static_cast<uint32_t>(writes.size()),
+                         writes.data(), 0, nullptr);
 }
 
-void VulkanEngine::createIndexBuffer() {
-  VkDeviceSize bufferSize =
-      sizeof(vertexData::indices[0]) * vertexData::indices.size();
+void VulkanEngine::reserveGpuObjects(GpuCullFrame &frame, uint32_t count) {
+  if (frame.objectCapacity >= count) {
+    return;
+  }
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  uint32_t capacity = std::max({count, frame.objectCapacity * 2, 1024u});
+  destroyGpuObjectBuffer(frame);
+
+  VkDeviceSize objectBufferSize = sizeof(GpuObject) * capacity;
+  createBuffer(objectBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               stagingBuffer, stagingBufferMemory);
-
-  void *data;
-  vkMapMemory(_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, vertexData::indices.data(), (size_t)bufferSize);
-  vkUnmapMemory(_device, stagingBufferMemory);
+               frame.objectBuffer, frame.objectBufferMemory);
+  vkMapMemory(_device, frame.objectBufferMemory, 0, objectBufferSize, 0,
+              &frame.objectsMapped);
+  frame.objectCapacity = capacity;
 
-  createBuffer(
-      bufferSize,
-      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _indexBuffer, _indexBufferMemory);
+  writeCullObjects(frame.sprites, frame.objectBuffer);
+}
 
-  copyBuffer(stagingBuffer, _indexBuffer, bufferSize);
+void VulkanEngine::destroyGpuObjectBuffer(GpuCullFrame &frame) {
+  if (frame.objectBufferMemory != VK_NULL_HANDLE) {
+    vkUnmapMemory(_device, frame.objectBufferMemory);
+    vkFreeMemory(_device, frame.objectBufferMemory, nullptr);
+    frame.objectBufferMemory = VK_NULL_HANDLE;
+  }
+  if (frame.objectBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, frame.objectBuffer, nullptr);
+    frame.objectBuffer = VK_NULL_HANDLE;
+  }
+  frame.objectsMapped = nullptr;
+  frame.objectCapacity = 0;
+}
 
-  vkDestroyBuffer(_device, stagingBuffer, nullptr);
-  vkFreeMemory(_device, stagingBufferMemory, nullptr);
+void VulkanEngine::writeBindlessTexture(uint32_t slot,
+                                        const Texture &texture) {
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = texture.view;
+  imageInfo.sampler = texture.sampler;
+
+  for (const auto &frame : _gpuCullFrames) {
+    for (VkDescriptorSet drawSet :
+         {frame.sprites.drawSet, frame.meshes.drawSet}) {
+      VkWriteDescriptorSet write{};
+      write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      write.dstSet = drawSet;
+      write.dstBinding = 2;
+      write.dstArrayElement = slot;
+      write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      write.descriptorCount = 1;
+      write.pImageInfo = &imageInfo;
+      vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+    }
+  }
 }
 
-void VulkanEngine::createDescriptorSetLayout() {
-  VkDescriptorSetLayoutBinding uboLayoutBinding{};
-  uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  uboLayoutBinding.pImmutableSamplers = nullptr;
-
-  VkDescriptorSetLayoutBinding samplerlayoutBinding{};
-  samplerlayoutBinding.binding = 1;
-  samplerlayoutBinding.descriptorCount = 1;
-  samplerlayoutBinding.descriptorType =
-      VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerlayoutBinding.pImmutableSamplers = nullptr;
-  samplerlayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+uint32_t VulkanEngine::bindlessSlot(uint32_t textureId) const {
+  // slot 0 holds the placeholder
+  if (!_textures[textureId].resident || textureId + 1 >= maxBindlessTextures) {
+    return 0;
+  }
+  return textureId + 1;
+}
 
-  std::array<VkDescriptorSetLayoutBinding, 2> binding = {uboLayoutBinding,
-                                                         samplerlayoutBinding};
+void VulkanEngine::cullObjects(VkCommandBuffer commandBuffer,
+                               uint32_t currentFrame) {
+  GpuCullFrame &frame = _gpuCullFrames[currentFrame];
+  frame.meshes.submittedObjects = 0;
+  frame.sprites.submittedObjects = 0;
+  glm::vec4 viewRect = cameraRect();
+
+  uint32_t meshCount = static_cast<uint32_t>(_meshObjects.size());
+  if (meshCount > 0) {
+    reserveCullDraws(frame.meshes, meshCount);
+    // no compaction, every mesh keeps its slot so both passes keep the
+    // order of _meshObjects
+    frame.meshes.orderedFirst = 0;
+    frame.meshes.expectedVisible = 0;
+    if (_validateGpuCulling) {
+      for (const auto &object : _meshObjects) {
+        frame.meshes.expectedVisible +=
+            gpuObjectVisible(object, viewRect) ? 1 : 0;
+      }
+    }
+    dispatchCull(commandBuffer, frame.meshes, meshCount, viewRect);
+  }
 
-  VkDescriptorSetLayoutCreateInfo layoutInfo{};
-  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layoutInfo.bindingCount = static_cast<uint32_t>(binding.size());
-  layoutInfo.pBindings = binding.data();
+  if (!_gpuCulling || _stressSprites.empty()) {
+    return;
+  }
 
-  if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr,
-                                  &_descriptorSetLayout) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create descriptor set layout");
+  uint32_t objectCount = static_cast<uint32_t>(_stressSprites.size());
+  reserveGpuObjects(frame, objectCount);
+  reserveCullDraws(frame.sprites, objectCount);
+
+  uint32_t quadIndexCount =
+      static_cast<uint32_t>(vertexData::indices.size());
+  GpuObject *objects = static_cast<GpuObject *>(frame.objectsMapped);
+  uint32_t expectedVisible = 0;
+
+  for (uint32_t i = 0; i < objectCount; i++) {
+    const SpriteInstance &sprite = _stressSprites[i];
+
+    GpuObject object{};
+    object.bounds = glm::vec4(-0.5f, -0.5f, 0.5f, 0.5f);
+    object.uvRect = sprite.uvRect;
+    object.transform = sprite.transform;
+    object.tint = sprite.tint;
+    object.textureIndex = bindlessSlot(sprite.textureId);
+    object.firstIndex = 0;
+    object.indexCount = quadIndexCount;
+    object.vertexOffset = 0;
+
+    if (_validateGpuCulling && gpuObjectVisible(object, viewRect)) {
+      expectedVisible++;
+    }
+    objects[i] = object;
   }
-}
 
-void VulkanEngine::createUniformBuffers() {
-  VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+  // sprites are drawn in any order, every command is compacted
+  frame.sprites.orderedFirst = objectCount;
+  frame.sprites.expectedVisible = expectedVisible;
+  dispatchCull(commandBuffer, frame.sprites, objectCount, viewRect);
+}
 
-  _uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-  _uniformBufferMemory.resize(MAX_FRAMES_IN_FLIGHT);
-  _uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+void VulkanEngine::dispatchCull(VkCommandBuffer commandBuffer,
+                                GpuCullBatch &batch, uint32_t objectCount,
+                                glm::vec4 viewRect) {
+  vkCmdFillBuffer(commandBuffer, batch.countBuffer, 0, sizeof(GpuCullCounts),
+                  0);
+
+  VkMemoryBarrier clearBarrier{};
+  clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  clearBarrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &clearBarrier, 0, nullptr, 0, nullptr);
+
+  CullPushConstants push{};
+  push.viewRect = viewRect;
+  push.objectCount = objectCount;
+  push.orderedFirst = batch.orderedFirst;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    _cullPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          _cullPipelineLayout, 0, 1, &batch.cullSet, 0,
+                          nullptr);
+  vkCmdPushConstants(commandBuffer, _cullPipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     offsetof(CullPushConstants, padding), &push);
+  vkCmdDispatch(commandBuffer, (objectCount + 63) / 64, 1, 1);
+
+  // draws and counts feed the indirect draws, the counts are also read back
+  VkMemoryBarrier cullBarrier{};
+  cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  cullBarrier.dstAccessMask =
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                           VK_PIPELINE_STAGE_HOST_BIT,
+                       0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+  batch.submittedObjects = objectCount;
+}
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 _uniformBuffers[i], _uniformBufferMemory[i]);
+void VulkanEngine::drawGpuObjects(VkCommandBuffer commandBuffer,
+                                  uint32_t currentFrame) {
+  const GpuCullBatch &batch = _gpuCullFrames[currentFrame].sprites;
+  if (batch.submittedObjects == 0) {
+    return;
+  }
 
-    vkMapMemory(_device, _uniformBufferMemory[i], 0, bufferSize, 0,
-                &_uniformBuffersMapped[i]);
+  VkPipeline pipeline = _pipelineRegistry.request(_gpuSpritePipeline);
+  if (pipeline == VK_NULL_HANDLE) {
+    return;
   }
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          _bindlessPipelineLayout, 0, 1, &batch.drawSet, 0,
+                          nullptr);
+
+  VkBuffer vertexBuffers[] = {_spriteQuadVertexBuffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, _spriteQuadIndexBuffer, 0,
+                       _spriteQuadIndexType);
+
+  vkCmdDrawIndexedIndirectCount(commandBuffer, batch.drawBuffer, 0,
+                                batch.countBuffer,
+                                offsetof(GpuCullCounts, compacted),
+                                batch.submittedObjects,
+                                sizeof(VkDrawIndexedIndirectCommand));
+  _drawStats.spriteDraws++;
+  _drawStats.sprites += batch.submittedObjects;
 }
 
-void VulkanEngine::updateUniformBuffer(uint32_t currentImage) {
-  static auto startTime = std::chrono::high_resolution_clock::now();
+void VulkanEngine::drawGpuMeshes(VkCommandBuffer commandBuffer,
+                                 uint32_t currentFrame, bool ordered) {
+  const GpuCullBatch &batch = _gpuCullFrames[currentFrame].meshes;
+  uint32_t first = ordered ? _meshBlendedFirst : 0;
+  uint32_t count = ordered ? batch.submittedObjects - _meshBlendedFirst
+                           : _meshBlendedFirst;
+  if (batch.submittedObjects == 0 || count == 0) {
+    return;
+  }
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    ordered ? _gpuMeshBlendPipeline : _gpuMeshPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          _bindlessPipelineLayout, 0, 1, &batch.drawSet, 0,
+                          nullptr);
+
+  VkBuffer vertexBuffers[] = {_meshVertexBuffer};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, _meshIndexBuffer, 0,
+                       VK_INDEX_TYPE_UINT32);
+
+  // culled meshes are left in as zero-instance commands
+  vkCmdDrawIndexedIndirect(commandBuffer, batch.drawBuffer,
+                           sizeof(VkDrawIndexedIndirectCommand) * first,
+                           count, sizeof(VkDrawIndexedIndirectCommand));
+  _drawStats.meshDraws++;
+}
+
+void VulkanEngine::sortMeshDraws(glm::vec4 viewRect) {
+  _drawList.clear();
+  for (uint32_t i = 0; i < _meshes.size(); i++) {
+    const Mesh &mesh = _meshes[i];
+    GpuObject object{};
+    object.bounds = mesh.localBounds;
+    object.transform = mesh.transform;
+    if (gpuObjectVisible(object, viewRect)) {
+      _drawList.add(meshDrawKey(mesh, i), i);
+    }
+  }
+  _drawList.sort();
+  _meshVisibleCount = static_cast<uint32_t>(_drawList.items().size());
+}
+
+void VulkanEngine::drawMeshes(VkCommandBuffer commandBuffer, uint32_t pass) {
+  // items come sorted by variant within a layer, so one lookup per run
+  uint32_t itemVariant = ~0u;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkPipeline boundPipeline = VK_NULL_HANDLE;
+  VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+  bool geometryBound = false;
+
+  for (const auto &item : _drawList.items()) {
+    if (drawKey::pass(item.key) != pass) {
+      continue;
+    }
+    const Mesh &mesh = _meshes[item.index];
+
+    uint32_t variant = drawKey::pipeline(item.key);
+    if (variant != itemVariant) {
+      pipeline = meshPipeline(variant / 2, variant % 2 != 0);
+      itemVariant = variant;
+    }
+    if (boundPipeline != pipeline) {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipeline);
+      boundPipeline = pipeline;
+      _drawStats.binds++;
+    }
+
+    // every mesh lives in the shared geometry buffers
+    if (!geometryBound) {
+      VkBuffer vertexBuffers[] = {_meshVertexBuffer};
+      VkDeviceSize offsets[] = {0};
+      vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+      vkCmdBindIndexBuffer(commandBuffer, _meshIndexBuffer, 0,
+                           VK_INDEX_TYPE_UINT32);
+      geometryBound = true;
+      _drawStats.binds += 2;
+    }
+
+    VkDescriptorSet descriptorSet = textureDescriptorSet(mesh.textureId);
+    if (boundDescriptorSet != descriptorSet) {
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                              _pipelineLayout, 0, 1, &descriptorSet, 0,
+                              nullptr);
+      boundDescriptorSet = descriptorSet;
+      _drawStats.binds++;
+    }
+
+    SpritePushConstants push{};
+    push.model = mesh.transform;
+    push.atlasColumns = mesh.animation.columns;
+    push.atlasRows = mesh.animation.rows;
+    push.baseFrame = mesh.animation.baseFrame;
+    push.frameCount = mesh.animation.frameCount;
+    push.fps = mesh.animation.fps;
+    push.startTime = mesh.animation.startTime;
+    push.loop = mesh.animation.loop ? 1 : 0;
+    push.depth = layerDepth(mesh.layer);
+    vkCmdPushConstants(commandBuffer, _pipelineLayout,
+                       VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+
+    vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, mesh.firstIndex,
+                     mesh.vertexOffset, 0);
+    _drawStats.meshDraws++;
+    // unsorted, at worst pipeline and texture change with every mesh
+    _drawStats.unsortedBinds += 2;
+  }
+  if (geometryBound) {
+    _drawStats.unsortedBinds += 2;
+  }
+}
+
+void VulkanEngine::readGpuCullResult(uint32_t currentFrame) {
+  if (_gpuCullFrames.empty()) {
+    return;
+  }
+
+  // called after this frame's fence, the counts are from its last submission
+  GpuCullFrame &frame = _gpuCullFrames[currentFrame];
+  if (frame.meshes.submittedObjects != 0) {
+    _meshVisibleCount = readCullCounts(frame.meshes, "mesh");
+  }
+  if (frame.sprites.submittedObjects != 0) {
+    _gpuVisibleCount = readCullCounts(frame.sprites, "sprite");
+  }
+}
+
+uint32_t VulkanEngine::readCullCounts(GpuCullBatch &batch, const char *name) {
+  uint32_t visible = batch.countMapped->compacted + batch.countMapped->ordered;
+  if (_validateGpuCulling && visible != batch.expectedVisible) {
+    std::cout << "gpu " << name << " culling mismatch: " << visible
+              << " visible, cpu expected " << batch.expectedVisible << "\n";
+  }
+  batch.submittedObjects = 0;
+  return visible;
+}
+
+void VulkanEngine::meshChanged(uint32_t mesh) {
+  // meshes added since the last rebuild are written in full anyway
+  if (mesh < _meshChangedFlags.size() && !_meshChangedFlags[mesh]) {
+    _meshChangedFlags[mesh] = 1;
+    _meshesChanged.push_back(mesh);
+  }
+}
+
+GpuObject VulkanEngine::meshObject(const Mesh &mesh) const {
+  GpuObject object{};
+  object.bounds = mesh.localBounds;
+  object.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+  object.transform = mesh.transform;
+  object.tint = 0xffffffffu;
+  object.textureIndex = bindlessSlot(mesh.textureId);
+  object.firstIndex = mesh.firstIndex;
+  object.indexCount = mesh.indexCount;
+  object.vertexOffset = mesh.vertexOffset;
+  object.atlasColumns = mesh.animation.columns;
+  object.atlasRows = mesh.animation.rows;
+  object.baseFrame = mesh.animation.baseFrame;
+  object.frameCount = mesh.animation.frameCount;
+  object.fps = mesh.animation.fps;
+  object.startTime = mesh.animation.startTime;
+  object.loop = mesh.animation.loop ? 1 : 0;
+  object.depth = layerDepth(mesh.layer);
+  return object;
+}
+
+void VulkanEngine::rebuildMeshObjects() {
+  uint32_t meshCount = static_cast<uint32_t>(_meshes.size());
+  _drawList.clear();
+  for (uint32_t i = 0; i < meshCount; i++) {
+    _drawList.add(meshDrawKey(_meshes[i], i), i);
+  }
+  _drawList.sort();
+
+  _meshObjects.resize(meshCount);
+  _meshObjectOf.resize(meshCount);
+  _meshBlendedFirst = 0;
+  for (uint32_t i = 0; i < meshCount; i++) {
+    const DrawItem &item = _drawList.items()[i];
+    _meshObjectOf[item.index] = i;
+    _meshObjects[i] = meshObject(_meshes[item.index]);
+    if (drawKey::pass(item.key) == drawKey::opaquePass) {
+      _meshBlendedFirst = i + 1;
+    }
+  }
+
+  _meshChangedFlags.assign(meshCount, 0);
+  _meshesChanged.clear();
+  reserveMeshObjects(meshCount);
+  _meshObjectsRebuilt = true;
+}
+
+void VulkanEngine::reserveMeshObjects(uint32_t count) {
+  if (_meshObjectCapacity >= count) {
+    return;
+  }
+
+  // shared by every frame, so the ones in flight have to finish first
+  if (_meshObjectBuffer != VK_NULL_HANDLE) {
+    vkDeviceWaitIdle(_device);
+  }
+  uint32_t capacity = std::max({count, _meshObjectCapacity * 2, 1024u});
+  destroyMeshObjectBuffer();
+
+  createBuffer(sizeof(GpuObject) * capacity,
+               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _meshObjectBuffer,
+               _meshObjectMemory);
+  _meshObjectCapacity = capacity;
+
+  for (auto &frame : _gpuCullFrames) {
+    writeCullObjects(frame.meshes, _meshObjectBuffer);
+  }
+}
+
+void VulkanEngine::destroyMeshObjectBuffer() {
+  if (_meshObjectBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, _meshObjectBuffer, nullptr);
+    _meshObjectBuffer = VK_NULL_HANDLE;
+  }
+  if (_meshObjectMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, _meshObjectMemory, nullptr);
+    _meshObjectMemory = VK_NULL_HANDLE;
+  }
+  _meshObjectCapacity = 0;
+}
+
+void VulkanEngine::reserveMeshStaging(GpuCullFrame &frame, uint32_t count) {
+  if (frame.meshStagingCapacity >= count) {
+    return;
+  }
+
+  uint32_t capacity = std::max({count, frame.meshStagingCapacity * 2, 256u});
+  destroyMeshStaging(frame);
+
+  VkDeviceSize size = sizeof(GpuObject) * capacity;
+  createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               frame.meshStaging, frame.meshStagingMemory);
+  vkMapMemory(_device, frame.meshStagingMemory, 0, size, 0,
+              &frame.meshStagingMapped);
+  frame.meshStagingCapacity = capacity;
+}
+
+void VulkanEngine::destroyMeshStaging(GpuCullFrame &frame) {
+  if (frame.meshStagingMemory != VK_NULL_HANDLE) {
+    vkUnmapMemory(_device, frame.meshStagingMemory);
+    vkFreeMemory(_device, frame.meshStagingMemory, nullptr);
+    frame.meshStagingMemory = VK_NULL_HANDLE;
+  }
+  if (frame.meshStaging != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, frame.meshStaging, nullptr);
+    frame.meshStaging = VK_NULL_HANDLE;
+  }
+  frame.meshStagingMapped = nullptr;
+  frame.meshStagingCapacity = 0;
+}
+
+void VulkanEngine::flushMeshObjects(VkCommandBuffer commandBuffer,
+                                    uint32_t currentFrame) {
+  if (_meshObjectOf.size() != _meshes.size()) {
+    rebuildMeshObjects();
+  }
+  if (_meshObjects.empty()) {
+    return;
+  }
+
+  // runs of consecutive changed objects, one copy each
+  std::vector<VkBufferCopy> copies;
+  uint32_t objectCount = 0;
+  if (_meshObjectsRebuilt) {
+    objectCount = static_cast<uint32_t>(_meshObjects.size());
+    copies.push_back({0, 0, sizeof(GpuObject) * objectCount});
+  } else {
+    if (_meshesChanged.empty()) {
+      return;
+    }
+    std::vector<uint32_t> changed;
+    changed.reserve(_meshesChanged.size());
+    for (uint32_t mesh : _meshesChanged) {
+      _meshChangedFlags[mesh] = 0;
+      uint32_t object = _meshObjectOf[mesh];
+      _meshObjects[object] = meshObject(_meshes[mesh]);
+      changed.push_back(object);
+    }
+    std::sort(changed.begin(), changed.end());
+
+    for (uint32_t object : changed) {
+      VkDeviceSize dstOffset = sizeof(GpuObject) * object;
+      VkDeviceSize srcOffset = sizeof(GpuObject) * objectCount;
+      if (!copies.empty() &&
+          copies.back().dstOffset + copies.back().size == dstOffset) {
+        copies.back().size += sizeof(GpuObject);
+      } else {
+        copies.push_back({srcOffset, dstOffset, sizeof(GpuObject)});
+      }
+      objectCount++;
+    }
+  }
+  _meshesChanged.clear();
+  _meshObjectsRebuilt = false;
+
+  // this frame's fence has been waited on, its staging buffer is free
+  GpuCullFrame &frame = _gpuCullFrames[currentFrame];
+  reserveMeshStaging(frame, objectCount);
+  auto *staging = static_cast<uint8_t *>(frame.meshStagingMapped);
+  for (const auto &copy : copies) {
+    memcpy(staging + copy.srcOffset,
+           reinterpret_cast<const uint8_t *>(_meshObjects.data()) +
+               copy.dstOffset,
+           copy.size);
+  }
+
+  // earlier frames may still be culling or drawing from the objects
+  VkMemoryBarrier before{};
+  before.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  before.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0,
+                       nullptr, 0, nullptr);
+
+  vkCmdCopyBuffer(commandBuffer, frame.meshStaging, _meshObjectBuffer,
+                  static_cast<uint32_t>(copies.size()), copies.data());
+
+  VkMemoryBarrier after{};
+  after.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  after.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                       0, 1, &after, 0, nullptr, 0, nullptr);
+
+  _drawStats.meshObjectUploads = objectCount;
+}
+
+void VulkanEngine::recreateSwapChain() {
+  int width = 0, height = 0;
+
+  SDL_GetWindowSize(_window, &width, &height);
+  if (width <= 0 || height <= 0) {
+    _resized = true;
+  }
+
+  vkDeviceWaitIdle(_device);
+
+  cleanupSwapChain();
 
-  auto currentTime = std::chrono::high_resolution_clock::now();
-  float time = std::chrono::duration<float, std::chrono::seconds::period>(
-                   currentTime - startTime)
-                   .count();
+  createSwapchain();
+  // createImageViews();
+  createDepthResources();
+}
 
+void VulkanEngine::cleanupSwapChain() {
+  destroyDepthResources();
+
+  for (auto imageView : _swapchainImageViews) {
+    vkDestroyImageView(_device, imageView, nullptr);
+  }
+
+  _swapchainImageViews.clear();
+
+  vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+}
+
+VkFormat VulkanEngine::findDepthFormat() const {
+  // 256 layers fit in either, D16 is the guaranteed fallback
+  for (VkFormat format : {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(_physicalDevice, format, &properties);
+    if (properties.optimalTilingFeatures &
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+      return format;
+    }
+  }
+  throw std::runtime_error("failed to find a depth format");
+}
+
+void VulkanEngine::createDepthResources() {
+  if (!_depthEnabled) {
+    return;
+  }
+
+  createImage(_swapchainExtent.width, _swapchainExtent.height, _depthFormat,
+              VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _depthImage,
+              _depthImageMemory);
+  _depthImageView = createImageView(_depthImage, _depthFormat, 1,
+                                    VK_IMAGE_ASPECT_DEPTH_BIT);
+}
+
+void VulkanEngine::destroyDepthResources() {
+  if (_depthImageView != VK_NULL_HANDLE) {
+    vkDestroyImageView(_device, _depthImageView, nullptr);
+    _depthImageView = VK_NULL_HANDLE;
+  }
+  if (_depthImage != VK_NULL_HANDLE) {
+    vkDestroyImage(_device, _depthImage, nullptr);
+    _depthImage = VK_NULL_HANDLE;
+  }
+  if (_depthImageMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, _depthImageMemory, nullptr);
+    _depthImageMemory = VK_NULL_HANDLE;
+  }
+}
+
+void VulkanEngine::createOverdrawQueries() {
+  if (!_overdrawQuerySupported) {
+    return;
+  }
+
+  VkQueryPoolCreateInfo queryPoolInfo{};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+  queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT;
+  queryPoolInfo.pipelineStatistics =
+      VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+  if (vkCreateQueryPool(_device, &queryPoolInfo, nullptr,
+                        &_overdrawQueryPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create overdraw query pool");
+  }
+  _overdrawQueryIssued.assign(MAX_FRAMES_IN_FLIGHT, false);
+}
+
+void VulkanEngine::readOverdrawQuery(uint32_t currentFrame) {
+  if (_overdrawQueryPool == VK_NULL_HANDLE ||
+      !_overdrawQueryIssued[currentFrame]) {
+    return;
+  }
+
+  // the frame's fence has signalled, the result is available without waiting
+  uint64_t invocations = 0;
+  if (vkGetQueryPoolResults(_device, _overdrawQueryPool, currentFrame, 1,
+                            sizeof(invocations), &invocations,
+                            sizeof(invocations),
+                            VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+    _fragmentInvocations = invocations;
+  }
+  _overdrawQueryIssued[currentFrame] = false;
+}
+
+void VulkanEngine::createVertexBuffer() {
+
+  VkDeviceSize bufferSize =
+      sizeof(vertexData::vertices[0]) * vertexData::vertices.size();
+
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingBufferMemory;
+
+  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               stagingBuffer, stagingBufferMemory);
+
+  void *data;
+  vkMapMemory(_device, stagingBufferMemory, 0, bufferSize, 0, &data);
+  memcpy(data, vertexData::vertices.data(), (size_t)bufferSize);
+  vkUnmapMemory(_device, stagingBufferMemory);
+
+  createBuffer(
+      bufferSize,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _vertexBuffer, _vertexBufferMemory);
+
+  copyBuffer(stagingBuffer, _vertexBuffer, bufferSize);
+
+  vkDestroyBuffer(_device, stagingBuffer, nullptr);
+  vkFreeMemory(_device, stagingBufferMemory, nullptr);
+}
+
+uint32_t VulkanEngine::findMemoryType(uint32_t typeFilter,
+                                      VkMemoryPropertyFlags properties) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &memProperties);
+
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags &
+                                    properties) == properties) {
+      return i;
+    }
+  }
+  throw std::runtime_error("failed to find suitable memory type");
+}
+
+void VulkanEngine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                VkMemoryPropertyFlags properties,
+                                VkBuffer &buffer,
+                                VkDeviceMemory &bufferMemory) {
+
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create buffer");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(_device, buffer, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex =
+      findMemoryType(memRequirements.memoryTypeBits, properties);
+
+  if (vkAllocateMemory(_device, &allocInfo, nullptr, &bufferMemory) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate vertex buffer memory");
+  }
+
+  vkBindBufferMemory(_device, buffer, bufferMemory, 0);
+}
+
+void VulkanEngine::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer,
+                              VkDeviceSize size, VkDeviceSize dstOffset) {
+
+  VkCommandBuffer commandBuffer =
+      vkinit::beginSingleTimeCommands(_commandPool, _device);
+
+  VkBufferCopy copyRegion{};
+  copyRegion.dstOffset = dstOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+  vkinit::endSingleTimeCommands(commandBuffer, _graphicsQueue, _device,
+                                _commandPool);
+}
+
+void VulkanEngine::createIndexBuffer() {
+  VkDeviceSize bufferSize =
+      sizeof(vertexData::indices[0]) * vertexData::indices.size();
+
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingBufferMemory;
+  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               stagingBuffer, stagingBufferMemory);
+
+  void *data;
+  vkMapMemory(_device, stagingBufferMemory, 0, bufferSize, 0, &data);
+  memcpy(data, vertexData::indices.data(), (size_t)bufferSize);
+  vkUnmapMemory(_device, stagingBufferMemory);
+
+  createBuffer(
+      bufferSize,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _indexBuffer, _indexBufferMemory);
+
+  copyBuffer(stagingBuffer, _indexBuffer, bufferSize);
+
+  vkDestroyBuffer(_device, stagingBuffer, nullptr);
+  vkFreeMemory(_device, stagingBufferMemory, nullptr);
+}
+
+void VulkanEngine::createDescriptorSetLayout() {
+  _layoutCache.init(_device);
+
+  const auto &meshLayout = _layoutCache.get(
+      {embeddedShaders::shader_vert, embeddedShaders::shader_frag});
+  if (meshLayout.pushConstants.size != sizeof(SpritePushConstants)) {
+    throw std::runtime_error("shader.vert push constants do not match "
+                             "SpritePushConstants");
+  }
+  _pipelineLayout = meshLayout.layout;
+  _descriptorSetLayout = meshLayout.setLayouts[0];
+
+  // same set layout as the meshes, so their descriptor sets are shared, but
+  // without the push range the pipeline layouts differ
+  const auto &spriteLayout = _layoutCache.get(
+      {embeddedShaders::sprite_vert, embeddedShaders::sprite_frag});
+  if (spriteLayout.setLayouts[0] != _descriptorSetLayout) {
+    throw std::runtime_error("sprite shaders do not match the mesh "
+                             "descriptor set layout");
+  }
+  _spritePipelineLayout = spriteLayout.layout;
+}
+
+void VulkanEngine::createUniformBuffers() {
+  VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+
+  _uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+  _uniformBufferMemory.resize(MAX_FRAMES_IN_FLIGHT);
+  _uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 _uniformBuffers[i], _uniformBufferMemory[i]);
+
+    vkMapMemory(_device, _uniformBufferMemory[i], 0, bufferSize, 0,
+                &_uniformBuffersMapped[i]);
+  }
+}
+
+float VulkanEngine::engineTime() const {
+  return std::chrono::duration<float, std::chrono::seconds::period>(
+             std::chrono::high_resolution_clock::now() - _startTime)
+      .count();
+}
+
+glm::vec2 VulkanEngine::cameraExtent() const {
+  float aspect = _swapchainExtent.width / (float)_swapchainExtent.height;
+
+  float worldWidth = 10.0f;
+  float worldHeight = worldWidth / aspect;
+
+  return glm::vec2(worldWidth, worldHeight) / _camera2d.cameraZoom;
+}
+
+glm::vec4 VulkanEngine::cameraRect() const {
+  glm::vec2 center = glm::vec2(_camera2d.cameraPosition);
+  glm::vec2 half = cameraExtent() * 0.5f;
+  return glm::vec4(center - half, center + half);
+}
+
+void VulkanEngine::updateUniformBuffer(uint32_t currentImage) {
   UniformBufferObject ubo{};
+  ubo.time = engineTime();
   // ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f),
   //                         glm::vec3(0.0f, 0.0f, 1.0f));
 
@@ -947,19 +2042,13 @@ void VulkanEngine::updateUniformBuffer(uint32_t currentImage) {
 
   // ubo.view = glm::lookAt(_cameraPos, _cameraPos + _cameraFront, _cameraUp);
 
-  ubo.view = glm::translate(glm::mat4(1.0f), -_camera2d.cameraPosition);
+  glm::mat4 view = glm::translate(glm::mat4(1.0f), -_camera2d.cameraPosition);
 
-  float aspect = _swapchainExtent.width / (float)_swapchainExtent.height;
   float orthoSize = 2.0f / _camera2d.cameraZoom;
 
-  float worldWidth = 10.0f;
-  float worldHeight = worldWidth / aspect;
-
-  worldWidth /= _camera2d.cameraZoom;
-  worldHeight /= _camera2d.cameraZoom;
-
-  ubo.proj = glm::ortho(-worldWidth / 2, worldWidth / 2, -worldHeight / 2,
-                        worldHeight / 2, -1.0f, 1.0f);
+  glm::vec2 extent = cameraExtent();
+  glm::mat4 proj = glm::ortho(-extent.x / 2, extent.x / 2, -extent.y / 2,
+                              extent.y / 2, -1.0f, 1.0f);
 
   // ubo.proj = glm::ortho(-orthoSize * aspect, orthoSize * aspect, -orthoSize,
   //                       orthoSize, -1.0f, 1.0f);
@@ -968,7 +2057,8 @@ void VulkanEngine::updateUniformBuffer(uint32_t currentImage) {
   //     glm::radians(45.0f),
   //    _swapchainExtent.width / (float)_swapchainExtent.height, 0.1f, 10.0f);
 
-  ubo.proj[1][1] *= -1;
+  proj[1][1] *= -1;
+  ubo.viewProj = proj * view;
 
   memcpy(_uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
 }
@@ -978,11 +2068,17 @@ void VulkanEngine::createDescriptorPool() {
   uint32_t maxMashes = 100;
   uint32_t totalDescriptorSets = maxMashes * MAX_FRAMES_IN_FLIGHT;
 
-  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  // plus per frame: a cull set (3 storage buffers) and a bindless draw set
+  // (ubo, objects, texture array) for the meshes and again for the sprites,
+  // and one tilemap set (ubo, atlas, tile index)
+  std::array<VkDescriptorPoolSize, 3> poolSizes{};
   poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  poolSizes[0].descriptorCount = totalDescriptorSets;
+  poolSizes[0].descriptorCount = totalDescriptorSets + 3 * MAX_FRAMES_IN_FLIGHT;
   poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  poolSizes[1].descriptorCount = maxMashes;
+  poolSizes[1].descriptorCount =
+      maxMashes + (2 * maxBindlessTextures + 2) * MAX_FRAMES_IN_FLIGHT;
+  poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[2].descriptorCount = 8 * MAX_FRAMES_IN_FLIGHT;
 
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1052,47 +2148,161 @@ void VulkanEngine::createDescriptorPool() {
 }*/
 
 void VulkanEngine::createMesh(const std::vector<vertexData::Vertex> &vertices,
-                              const std::vector<uint16_t> &indices,
+                              const std::vector<uint32_t> &indices,
                               const glm::mat4 &inittialTransform,
                               glm::vec3 position, const char *texturePath,
                               bool playerMesh) {
 
   Mesh newMesh;
-  newMesh.indexCount = static_cast<uint32_t>(indices.size());
-  newMesh.transform = inittialTransform;
+  newMesh.transform = glm::mat3x2(glm::vec2(inittialTransform[0]),
+                                  glm::vec2(inittialTransform[1]),
+                                  glm::vec2(inittialTransform[3]));
 
-  newMesh.position = position;
   newMesh.plyerMesh = playerMesh;
 
-  VkDeviceSize vertexBufferSize = sizeof(vertices[0]) * vertices.size();
-  createBuffer(vertexBufferSize,
+  uploadMesh(newMesh, vertices, indices);
+  newMesh.textureId = requestTexture(texturePath);
+
+  _meshes.push_back(newMesh);
+  _transforms.added(static_cast<uint32_t>(_meshes.size() - 1),
+                    glm::vec2(position));
+}
+
+void VulkanEngine::uploadMesh(Mesh &mesh,
+                              const std::vector<vertexData::Vertex> &vertices,
+                              const std::vector<uint32_t> &indices) {
+  mesh.indexCount = static_cast<uint32_t>(indices.size());
+
+  glm::vec2 lo(std::numeric_limits<float>::max());
+  glm::vec2 hi(std::numeric_limits<float>::lowest());
+  for (const auto &vertex : vertices) {
+    glm::vec2 vertexPosition = vertex.unpackPosition();
+    lo = glm::min(lo, vertexPosition);
+    hi = glm::max(hi, vertexPosition);
+  }
+  mesh.localBounds = glm::vec4(lo, hi);
+  mesh.updateBounds();
+
+  uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+  reserveMeshGeometry(_meshVertexCount + vertexCount,
+                      _meshIndexCount + mesh.indexCount);
+
+  // indices stay local to the mesh, vertexOffset moves them to its range
+  mesh.indexType = VK_INDEX_TYPE_UINT32;
+  mesh.firstIndex = _meshIndexCount;
+  mesh.vertexOffset = static_cast<int32_t>(_meshVertexCount);
+  uploadToBuffer(vertices.data(), sizeof(vertexData::Vertex) * vertexCount,
+                 _meshVertexBuffer,
+                 sizeof(vertexData::Vertex) * _meshVertexCount);
+  uploadToBuffer(indices.data(), sizeof(uint32_t) * mesh.indexCount,
+                 _meshIndexBuffer, sizeof(uint32_t) * _meshIndexCount);
+  _meshVertexCount += vertexCount;
+  _meshIndexCount += mesh.indexCount;
+}
+
+void VulkanEngine::reserveMeshGeometry(uint32_t vertexCount,
+                                       uint32_t indexCount) {
+  if (_meshVertexCapacity >= vertexCount && _meshIndexCapacity >= indexCount) {
+    return;
+  }
+
+  uint32_t vertexCapacity =
+      std::max({vertexCount, _meshVertexCapacity * 2, 4096u});
+  uint32_t indexCapacity =
+      std::max({indexCount, _meshIndexCapacity * 2, 4096u});
+
+  VkBuffer vertexBuffer, indexBuffer;
+  VkDeviceMemory vertexMemory, indexMemory;
+  createBuffer(sizeof(vertexData::Vertex) * vertexCapacity,
                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, newMesh.vertexBuffer,
-               newMesh.vertexBufferMemory);
-
-  VkDeviceSize indexBufferSize = sizeof(indices[0]) * indices.size();
-  createBuffer(indexBufferSize,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer,
+               vertexMemory);
+  createBuffer(sizeof(uint32_t) * indexCapacity,
                VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, newMesh.indexBuffer,
-               newMesh.indexBufferMemory);
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexMemory);
+
+  // frames in flight may be drawing from the old buffers
+  if (_meshVertexBuffer != VK_NULL_HANDLE) {
+    vkDeviceWaitIdle(_device);
+    if (_meshVertexCount > 0) {
+      copyBuffer(_meshVertexBuffer, vertexBuffer,
+                 sizeof(vertexData::Vertex) * _meshVertexCount);
+    }
+    if (_meshIndexCount > 0) {
+      copyBuffer(_meshIndexBuffer, indexBuffer,
+                 sizeof(uint32_t) * _meshIndexCount);
+    }
+  }
+  uint32_t usedVertices = _meshVertexCount;
+  uint32_t usedIndices = _meshIndexCount;
+  destroyMeshGeometry();
+
+  _meshVertexBuffer = vertexBuffer;
+  _meshVertexMemory = vertexMemory;
+  _meshIndexBuffer = indexBuffer;
+  _meshIndexMemory = indexMemory;
+  _meshVertexCount = usedVertices;
+  _meshIndexCount = usedIndices;
+  _meshVertexCapacity = vertexCapacity;
+  _meshIndexCapacity = indexCapacity;
+}
 
-  uploadToBuffer(vertices.data(), vertexBufferSize, newMesh.vertexBuffer);
-  uploadToBuffer(indices.data(), indexBufferSize, newMesh.indexBuffer);
+void VulkanEngine::destroyMeshGeometry() {
+  if (_meshVertexBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, _meshVertexBuffer, nullptr);
+    _meshVertexBuffer = VK_NULL_HANDLE;
+  }
+  if (_meshVertexMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, _meshVertexMemory, nullptr);
+    _meshVertexMemory = VK_NULL_HANDLE;
+  }
+  if (_meshIndexBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, _meshIndexBuffer, nullptr);
+    _meshIndexBuffer = VK_NULL_HANDLE;
+  }
+  if (_meshIndexMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, _meshIndexMemory, nullptr);
+    _meshIndexMemory = VK_NULL_HANDLE;
+  }
+  _meshVertexCount = 0;
+  _meshVertexCapacity = 0;
+  _meshIndexCount = 0;
+  _meshIndexCapacity = 0;
+}
 
-  createTextureImage(texturePath, newMesh.textureImage,
-                     newMesh.textureImageMemory);
-  createTextureImageView(newMesh.textureImage, newMesh.textureImageView);
-  createTextureSampler(newMesh.textureSampler);
+VkIndexType
+VulkanEngine::uploadIndexBuffer(const std::vector<uint32_t> &indices,
+                                size_t vertexCount, VkBuffer &buffer,
+                                VkDeviceMemory &bufferMemory) {
+  bool narrow = vertexCount <= std::numeric_limits<uint16_t>::max() + 1u;
+
+  std::vector<uint16_t> indices16;
+  const void *data = indices.data();
+  VkDeviceSize size = sizeof(uint32_t) * indices.size();
+  if (narrow) {
+    indices16.reserve(indices.size());
+    for (uint32_t index : indices) {
+      indices16.push_back(static_cast<uint16_t>(index));
+    }
+    data = indices16.data();
+    size = sizeof(uint16_t) * indices16.size();
+  }
 
-  createMeshDescriptorSet(newMesh);
+  createBuffer(size,
+               VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+  uploadToBuffer(data, size, buffer);
 
-  _meshes.push_back(newMesh);
+  return narrow ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 }
 
 void VulkanEngine::uploadToBuffer(const void *data, VkDeviceSize size,
-                                  VkBuffer dstBuffer) {
+                                  VkBuffer dstBuffer, VkDeviceSize dstOffset) {
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingBufferMemory;
 
@@ -1106,7 +2316,7 @@ void VulkanEngine::uploadToBuffer(const void *data, VkDeviceSize size,
   memcpy(mappedData, data, (size_t)size);
   vkUnmapMemory(_device, stagingBufferMemory);
 
-  copyBuffer(stagingBuffer, dstBuffer, size);
+  copyBuffer(stagingBuffer, dstBuffer, size, dstOffset);
 
   vkDestroyBuffer(_device, stagingBuffer, nullptr);
   vkFreeMemory(_device, stagingBufferMemory, nullptr);
@@ -1124,6 +2334,154 @@ void VulkanEngine::createAllMeshes() {
                  glm::scale(glm::mat4(1.0f), glm::vec3(1.0f)),
              glm::vec3(3.0f, -1.0f, 0.0f), "../textures/statue-1275469_640.jpg",
              false);
+
+  SpriteSheet appearing;
+  appearing.texturePath = "../textures/appearing.png";
+  appearing.columns = 7;
+  appearing.rows = 1;
+  appearing.clips.push_back({"appear", 0, 7, 10.0f, true});
+  _spriteSheets.push_back(appearing);
+
+  createAnimatedSprite(_spriteSheets.back(), "appear",
+                       glm::vec3(0.0f, -2.0f, 0.0f));
+
+  _stressTextureIds = {requestTexture("../textures/forest-2.png"),
+                       requestTexture("../textures/statue-1275469_640.jpg")};
+}
+
+void VulkanEngine::createAnimatedSprite(const SpriteSheet &sheet,
+                                        const char *clipName,
+                                        glm::vec3 position) {
+  const AnimationClip *clip = sheet.findClip(clipName);
+  if (clip == nullptr) {
+    throw std::runtime_error(std::string("unknown animation clip ") +
+                             clipName);
+  }
+
+  createMesh(vertexData::vertices, vertexData::indices,
+             glm::translate(glm::mat4(1.0f), position), position,
+             sheet.texturePath.c_str(), false);
+  _meshes.back().animation.play(sheet, *clip, engineTime());
+  // sprite sheets are cut out with alpha
+  _meshes.back().transparent = true;
+}
+
+void VulkanEngine::createSpriteBatchBuffers() {
+  VkDeviceSize vertexBufferSize =
+      sizeof(vertexData::vertices[0]) * vertexData::vertices.size();
+  createBuffer(vertexBufferSize,
+               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _spriteQuadVertexBuffer,
+               _spriteQuadVertexBufferMemory);
+  uploadToBuffer(vertexData::vertices.data(), vertexBufferSize,
+                 _spriteQuadVertexBuffer);
+
+  _spriteQuadIndexType = uploadIndexBuffer(
+      vertexData::indices, vertexData::vertices.size(), _spriteQuadIndexBuffer,
+      _spriteQuadIndexBufferMemory);
+
+  _spriteInstanceBuffers.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  _spriteInstanceBufferMemory.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  _spriteInstanceBuffersMapped.assign(MAX_FRAMES_IN_FLIGHT, nullptr);
+  _spriteInstanceCapacity.assign(MAX_FRAMES_IN_FLIGHT, 0);
+}
+
+void VulkanEngine::reserveSpriteInstances(uint32_t frame, uint32_t count) {
+  if (_spriteInstanceCapacity[frame] >= count) {
+    return;
+  }
+
+  uint32_t capacity =
+      std::max({count, _spriteInstanceCapacity[frame] * 2, 1024u});
+  destroySpriteInstanceBuffer(frame);
+
+  VkDeviceSize bufferSize = sizeof(SpriteInstance) * capacity;
+  createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               _spriteInstanceBuffers[frame],
+               _spriteInstanceBufferMemory[frame]);
+  vkMapMemory(_device, _spriteInstanceBufferMemory[frame], 0, bufferSize, 0,
+              &_spriteInstanceBuffersMapped[frame]);
+  _spriteInstanceCapacity[frame] = capacity;
+}
+
+void VulkanEngine::destroySpriteInstanceBuffer(uint32_t frame) {
+  if (_spriteInstanceBufferMemory[frame] != VK_NULL_HANDLE) {
+    vkUnmapMemory(_device, _spriteInstanceBufferMemory[frame]);
+    vkFreeMemory(_device, _spriteInstanceBufferMemory[frame], nullptr);
+    _spriteInstanceBufferMemory[frame] = VK_NULL_HANDLE;
+  }
+  if (_spriteInstanceBuffers[frame] != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, _spriteInstanceBuffers[frame], nullptr);
+    _spriteInstanceBuffers[frame] = VK_NULL_HANDLE;
+  }
+  _spriteInstanceBuffersMapped[frame] = nullptr;
+  _spriteInstanceCapacity[frame] = 0;
+}
+
+void VulkanEngine::updateStressSprites(float deltaTime) {
+  const glm::vec2 bounds(5.0f, 3.0f);
+  size_t count = static_cast<size_t>(std::max(_stressSpriteCount, 0));
+
+  if (_stressSprites.size() > count) {
+    _stressSprites.resize(count);
+    _stressState.resize(count);
+  }
+
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  while (_stressSprites.size() < count && !_stressTextureIds.empty()) {
+    size_t i = _stressSprites.size();
+    uint32_t textureSlot = static_cast<uint32_t>(i % _stressTextureIds.size());
+
+    SpriteInstance sprite{};
+    sprite.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    sprite.tint = packTint(glm::vec4(0.5f + unit(_stressRandom) * 0.5f,
+                                     0.5f + unit(_stressRandom) * 0.5f,
+                                     0.5f + unit(_stressRandom) * 0.5f, 1.0f));
+    sprite.textureId = _stressTextureIds[textureSlot];
+    _stressSprites.push_back(sprite);
+
+    float angle = unit(_stressRandom) * 6.2831853f;
+    float speed = 0.5f + unit(_stressRandom) * 1.5f;
+    float scale = 0.1f + unit(_stressRandom) * 0.15f;
+
+    _stressState.resize(i + 1);
+    _stressState.x[i] = (unit(_stressRandom) * 2.0f - 1.0f) * bounds.x;
+    _stressState.y[i] = (unit(_stressRandom) * 2.0f - 1.0f) * bounds.y;
+    _stressState.vx[i] = std::cos(angle) * speed;
+    _stressState.vy[i] = std::sin(angle) * speed;
+    _stressState.rot[i] = unit(_stressRandom) * 6.2831853f;
+    _stressState.sx[i] = scale;
+    _stressState.sy[i] = scale;
+  }
+
+  size_t spriteCount = _stressSprites.size();
+  transformKernels::integrate(_stressState, 0, spriteCount, deltaTime);
+  for (size_t i = 0; i < spriteCount; i++) {
+    _stressState.rot[i] += deltaTime;
+    if (std::abs(_stressState.x[i]) > bounds.x) {
+      _stressState.vx[i] = -_stressState.vx[i];
+    }
+    if (std::abs(_stressState.y[i]) > bounds.y) {
+      _stressState.vy[i] = -_stressState.vy[i];
+    }
+  }
+  transformKernels::buildAffine(_stressState, 0, spriteCount);
+
+  _spriteBatch.clear();
+  for (size_t i = 0; i < spriteCount; i++) {
+    SpriteInstance &sprite = _stressSprites[i];
+    sprite.transform =
+        glm::mat3x2(glm::vec2(_stressState.m00[i], _stressState.m10[i]),
+                    glm::vec2(_stressState.m01[i], _stressState.m11[i]),
+                    glm::vec2(_stressState.x[i], _stressState.y[i]));
+
+    if (!_gpuCulling) {
+      _spriteBatch.add(sprite);
+    }
+  }
 }
 
 void VulkanEngine::processInput(SDL_Event event) {
@@ -1138,9 +2496,9 @@ void VulkanEngine::processInput(SDL_Event event) {
   }
   if (_playerMode) {
     if (!_meshes.empty()) {
-      for (auto &playerMesh : _meshes) {
-        if (playerMesh.plyerMesh) {
-          _player2d.addMesh(playerMesh);
+      for (uint32_t i = 0; i < _meshes.size(); i++) {
+        if (_meshes[i].plyerMesh) {
+          _player2d.addMesh(_transforms, i);
           _player2d.playerMovement(event);
         }
       }
@@ -1174,71 +2532,367 @@ void VulkanEngine::initImGUI() {
   initInfo.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
   initInfo.PipelineRenderingCreateInfo.pColorAttachmentFormats =
       &_swapchainImageFormat;
+  initInfo.PipelineRenderingCreateInfo.depthAttachmentFormat = _depthFormat;
   initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 
-  ImGui_ImplVulkan_Init(&initInfo);
+  ImGui_ImplVulkan_Init(&initInfo);
+}
+
+void VulkanEngine::updateMeshes(float deltaTime) {
+  _transforms.update(deltaTime);
+  for (uint32_t mesh : _transforms.written()) {
+    meshChanged(mesh);
+  }
+}
+
+uint32_t VulkanEngine::requestTexture(const char *filePath) {
+  auto found = _textureIds.find(filePath);
+  if (found != _textureIds.end()) {
+    return found->second;
+  }
+
+  uint32_t textureId = static_cast<uint32_t>(_textures.size());
+  Texture texture;
+  texture.path = filePath;
+  _textures.push_back(texture);
+  _textureIds.emplace(texture.path, textureId);
+
+  // nothing is read yet, updateTextureStreaming picks the load order
+  _queuedTextures.push_back(textureId);
+  return textureId;
+}
+
+void VulkanEngine::startTextureLoad(uint32_t textureId) {
+  const Texture &texture = _textures[textureId];
+
+  DecodedTexture pending;
+  pending.textureId = textureId;
+
+  // only headers are read here; the staging size is known before any pixel
+  // is touched so the worker can fill the mapping without a round trip
+  auto cookedFile = std::make_shared<texfile::MappedFile>();
+  texfile::TextureView cooked;
+  bool useCooked = openCookedTexture(texture.path, *cookedFile, cooked);
+
+  VkDeviceSize stagingSize;
+  if (useCooked) {
+    pending.format = static_cast<VkFormat>(cooked.header->format);
+    pending.width = cooked.header->width;
+    pending.height = cooked.header->height;
+    pending.mipLevels = cooked.header->mipLevels;
+    stagingSize = cooked.header->payloadSize;
+
+    pending.regions.resize(pending.mipLevels);
+    for (uint32_t i = 0; i < pending.mipLevels; i++) {
+      VkBufferImageCopy &region = pending.regions[i];
+      region = {};
+      region.bufferOffset = cooked.levels[i].offset;
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.mipLevel = i;
+      region.imageSubresource.baseArrayLayer = 0;
+      region.imageSubresource.layerCount = 1;
+      region.imageOffset = {0, 0, 0};
+      region.imageExtent = {cooked.levels[i].width, cooked.levels[i].height,
+                            1};
+    }
+  } else {
+    if (!imageLoader::info(texture.path.c_str(), pending.width,
+                           pending.height)) {
+      textureLoadFailed(textureId);
+      return;
+    }
+    stagingSize = imageLoader::decodeSize(pending.width, pending.height);
+  }
+
+  createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               pending.stagingBuffer, pending.stagingBufferMemory);
+
+  void *staging;
+  vkMapMemory(_device, pending.stagingBufferMemory, 0, stagingSize, 0,
+              &staging);
+
+  _pendingTextureLoads++;
+
+  if (useCooked) {
+    const uint8_t *payload = cooked.payload;
+    _threadPool.submit(
+        [this, pending, cookedFile, payload, staging, stagingSize]() mutable {
+          memcpy(staging, payload, static_cast<size_t>(stagingSize));
+          cookedFile->close();
+          pending.loaded = true;
+          _decodedTextures.push(std::move(pending));
+        });
+  } else {
+    std::string path = texture.path;
+    _threadPool.submit(
+        [this, pending, path, staging, stagingSize]() mutable {
+          pending.loaded = imageLoader::decodeInto(
+              path.c_str(), staging, static_cast<size_t>(stagingSize),
+              pending.width, pending.height);
+          _decodedTextures.push(std::move(pending));
+        });
+  }
+}
+
+bool VulkanEngine::openCookedTexture(const std::string &filePath,
+                                     texfile::MappedFile &file,
+                                     texfile::TextureView &view) {
+  if (!_useCookedTextures || !file.open(texfile::cookedPath(filePath))) {
+    return false;
+  }
+
+  if (texfile::parse(file, view) &&
+      (_textureCompressionBC ||
+       !texfile::isBlockCompressed(static_cast<VkFormat>(view.header->format)))) {
+    return true;
+  }
+
+  file.close();
+  view = {};
+  return false;
 }
 
-void VulkanEngine::updateMeshes(float deltaTime) {
-  for (auto &mesh : _meshes) {
-    mesh.update(deltaTime);
+void VulkanEngine::updateTextureStreaming() {
+  for (size_t i = 0; i < _textureUploads.size();) {
+    if (vkGetFenceStatus(_device, _textureUploads[i].fence) != VK_SUCCESS) {
+      i++;
+      continue;
+    }
+    // the descriptor set was written before submission and never bound, so
+    // flipping resident is all the swap needs
+    uint32_t textureId = _textureUploads[i].textureId;
+    _textures[textureId].resident = true;
+    if (textureId + 1 < maxBindlessTextures) {
+      writeBindlessTexture(textureId + 1, _textures[textureId]);
+      // their objects still point at the placeholder slot
+      for (uint32_t mesh = 0; mesh < _meshes.size(); mesh++) {
+        if (_meshes[mesh].textureId == textureId) {
+          meshChanged(mesh);
+        }
+      }
+    }
+    retireTextureUpload(_textureUploads[i]);
+    _textureUploads[i] = _textureUploads.back();
+    _textureUploads.pop_back();
+  }
+
+  DecodedTexture decoded;
+  while (_decodedTextures.tryPop(decoded)) {
+    _pendingTextureLoads--;
+    createTextureImage(decoded, _textures[decoded.textureId]);
+  }
+
+  if (!_queuedTextures.empty() &&
+      _pendingTextureLoads < _maxTextureLoadsInFlight) {
+    // a texture is as urgent as the closest mesh that uses it, one pass
+    // over the meshes
+    std::vector<float> &distance = _textureDistance;
+    distance.assign(_textures.size(), std::numeric_limits<float>::max());
+    glm::vec2 camera = glm::vec2(_camera2d.cameraPosition);
+    for (const auto &mesh : _meshes) {
+      float meshDistance = glm::length(mesh.transform[2] - camera);
+      distance[mesh.textureId] =
+          std::min(distance[mesh.textureId], meshDistance);
+    }
+    // the map lies under the camera
+    if (!_tileChunks.empty()) {
+      distance[_tileTextureId] = 0.0f;
+    }
+
+    // only the loads started now are ordered: the nearest move to the back,
+    // farthest first, and are popped off it; the rest stay unsorted until
+    // a later frame has room for them
+    size_t dispatch =
+        std::min<size_t>(_queuedTextures.size(),
+                         _maxTextureLoadsInFlight - _pendingTextureLoads);
+    auto farther = [&distance](uint32_t a, uint32_t b) {
+      return distance[a] > distance[b];
+    };
+    auto nearest = _queuedTextures.end() - dispatch;
+    std::nth_element(_queuedTextures.begin(), nearest, _queuedTextures.end(),
+                     farther);
+    std::sort(nearest, _queuedTextures.end(), farther);
+
+    for (size_t i = 0; i < dispatch; i++) {
+      startTextureLoad(_queuedTextures.back());
+      _queuedTextures.pop_back();
+    }
+    _texturesStreaming = true;
+  }
+
+  if (_texturesStreaming && _queuedTextures.empty() &&
+      _pendingTextureLoads == 0 && _textureUploads.empty()) {
+    _texturesStreaming = false;
+    std::cout << _textures.size() - _failedTextures << " of "
+              << _textures.size() << " textures resident after "
+              << std::chrono::duration<double, std::milli>(
+                     std::chrono::high_resolution_clock::now() -
+                     _streamingStart)
+                     .count()
+              << " ms\n";
   }
 }
 
-void VulkanEngine::createTextureImage(const char *filePath,
-                                      VkImage &textureImage,
-                                      VkDeviceMemory &textureImageMemory) {
-  int texWidth, texHeight, texChannels;
-  stbi_uc *pixels =
-      stbi_load(filePath, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+void VulkanEngine::textureLoadFailed(uint32_t textureId) {
+  // streaming runs inside the frame loop, a bad file must not end the game
+  Texture &texture = _textures[textureId];
+  texture.failed = true;
+  _failedTextures++;
+  std::cout << "failed to load texture image " << texture.path
+            << ", keeping the placeholder\n";
+}
 
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
+void VulkanEngine::stopTextureStreaming() {
+  _queuedTextures.clear();
+  _threadPool.waitIdle();
 
-  if (!pixels) {
-    throw std::runtime_error("failed to load texture image");
+  DecodedTexture decoded;
+  while (_decodedTextures.tryPop(decoded)) {
+    _pendingTextureLoads--;
+    vkUnmapMemory(_device, decoded.stagingBufferMemory);
+    vkDestroyBuffer(_device, decoded.stagingBuffer, nullptr);
+    vkFreeMemory(_device, decoded.stagingBufferMemory, nullptr);
   }
 
-  VkBuffer staginBuffer;
-  VkDeviceMemory stagingBufferMemory;
+  for (auto &upload : _textureUploads) {
+    vkWaitForFences(_device, 1, &upload.fence, VK_TRUE, UINT64_MAX);
+    retireTextureUpload(upload);
+  }
+  _textureUploads.clear();
+}
 
-  createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+void VulkanEngine::retireTextureUpload(TextureUpload &upload) {
+  vkDestroyFence(_device, upload.fence, nullptr);
+  vkFreeCommandBuffers(_device, _commandPool, 1, &upload.commandBuffer);
+  vkDestroyBuffer(_device, upload.stagingBuffer, nullptr);
+  vkFreeMemory(_device, upload.stagingBufferMemory, nullptr);
+}
+
+void VulkanEngine::createPlaceholderTexture() {
+  // 1x1 neutral grey, uploaded synchronously before any mesh exists
+  const uint8_t pixel[4] = {128, 128, 128, 255};
+
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingBufferMemory;
+  createBuffer(sizeof(pixel), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               staginBuffer, stagingBufferMemory);
+               stagingBuffer, stagingBufferMemory);
 
   void *data;
-  vkMapMemory(_device, stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, static_cast<size_t>(imageSize));
+  vkMapMemory(_device, stagingBufferMemory, 0, sizeof(pixel), 0, &data);
+  memcpy(data, pixel, sizeof(pixel));
   vkUnmapMemory(_device, stagingBufferMemory);
 
-  stbi_image_free(pixels);
+  _placeholderTexture.path = "placeholder";
+  createImage(1, 1, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _placeholderTexture.image,
+              _placeholderTexture.memory);
 
-  createImage(
-      texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
-
-  vkinit::transitionImageLayout(textureImage, VK_IMAGE_LAYOUT_UNDEFINED,
+  vkinit::transitionImageLayout(_placeholderTexture.image,
+                                VK_IMAGE_LAYOUT_UNDEFINED,
                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                 _commandPool, _device, _graphicsQueue);
-
-  copyBufferToImage(staginBuffer, textureImage, static_cast<uint32_t>(texWidth),
-                    static_cast<uint32_t>(texHeight));
-
-  vkinit::transitionImageLayout(textureImage,
+  copyBufferToImage(stagingBuffer, _placeholderTexture.image, 1, 1);
+  vkinit::transitionImageLayout(_placeholderTexture.image,
                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                                 _commandPool, _device, _graphicsQueue);
 
-  vkDestroyBuffer(_device, staginBuffer, nullptr);
+  vkDestroyBuffer(_device, stagingBuffer, nullptr);
   vkFreeMemory(_device, stagingBufferMemory, nullptr);
+
+  createTextureImageView(_placeholderTexture.image, _placeholderTexture.view,
+                         VK_FORMAT_R8G8B8A8_SRGB, 1);
+  createTextureSampler(_placeholderTexture.sampler, 1);
+  createTextureDescriptorSet(_placeholderTexture);
+  _placeholderTexture.resident = true;
+}
+
+void VulkanEngine::createTextureImage(DecodedTexture &decoded,
+                                      Texture &texture) {
+  vkUnmapMemory(_device, decoded.stagingBufferMemory);
+
+  if (!decoded.loaded) {
+    vkDestroyBuffer(_device, decoded.stagingBuffer, nullptr);
+    vkFreeMemory(_device, decoded.stagingBufferMemory, nullptr);
+    textureLoadFailed(decoded.textureId);
+    return;
+  }
+
+  uint32_t mipLevels = decoded.mipLevels;
+
+  createImage(decoded.width, decoded.height, decoded.format,
+              VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture.image,
+              texture.memory, mipLevels);
+
+  if (decoded.regions.empty()) {
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {decoded.width, decoded.height, 1};
+    decoded.regions.push_back(region);
+  }
+
+  TextureUpload upload;
+  upload.textureId = decoded.textureId;
+  upload.stagingBuffer = decoded.stagingBuffer;
+  upload.stagingBufferMemory = decoded.stagingBufferMemory;
+
+  // recorded and submitted without waiting, the render loop polls the fence
+  upload.commandBuffer = vkinit::beginSingleTimeCommands(_commandPool, _device);
+
+  vkinit::transitionImage(upload.commandBuffer, texture.image,
+                          VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+  vkCmdCopyBufferToImage(upload.commandBuffer, decoded.stagingBuffer,
+                         texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(decoded.regions.size()),
+                         decoded.regions.data());
+  vkinit::transitionImage(upload.commandBuffer, texture.image,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+
+  vkEndCommandBuffer(upload.commandBuffer);
+
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(_device, &fenceInfo, nullptr, &upload.fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture upload fence");
+  }
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &upload.commandBuffer;
+
+  if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, upload.fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit texture upload");
+  }
+  _textureUploads.push_back(upload);
+
+  createTextureImageView(texture.image, texture.view, decoded.format,
+                         mipLevels);
+  createTextureSampler(texture.sampler, mipLevels);
+  createTextureDescriptorSet(texture);
 }
 
 void VulkanEngine::createImage(uint32_t width, uint32_t height, VkFormat format,
                                VkImageTiling tiling, VkImageUsageFlags usage,
                                VkMemoryPropertyFlags properties,
                                VkImage &textureImage,
-                               VkDeviceMemory &textureImageMemory) {
+                               VkDeviceMemory &textureImageMemory,
+                               uint32_t mipLevels) {
 
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1246,7 +2900,7 @@ void VulkanEngine::createImage(uint32_t width, uint32_t height, VkFormat format,
   imageInfo.extent.width = width;
   imageInfo.extent.height = height;
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
+  imageInfo.mipLevels = mipLevels;
   imageInfo.arrayLayers = 1;
   imageInfo.format = format;
   imageInfo.tiling = tiling;
@@ -1328,9 +2982,6 @@ void VulkanEngine::createImage(uint32_t width, uint32_t height, VkFormat format,
 void VulkanEngine::copyBufferToImage(VkBuffer buffer, VkImage image,
                                      uint32_t width, uint32_t height) {
 
-  VkCommandBuffer commandBuffer =
-      vkinit::beginSingleTimeCommands(_commandPool, _device);
-
   VkBufferImageCopy region{};
   region.bufferOffset = 0;
   region.bufferRowLength = 0;
@@ -1344,19 +2995,35 @@ void VulkanEngine::copyBufferToImage(VkBuffer buffer, VkImage image,
   region.imageOffset = {0, 0, 0};
   region.imageExtent = {width, height, 1};
 
+  copyBufferToImage(buffer, image, std::vector<VkBufferImageCopy>{region});
+}
+
+void VulkanEngine::copyBufferToImage(
+    VkBuffer buffer, VkImage image,
+    const std::vector<VkBufferImageCopy> &regions) {
+
+  VkCommandBuffer commandBuffer =
+      vkinit::beginSingleTimeCommands(_commandPool, _device);
+
   vkCmdCopyBufferToImage(commandBuffer, buffer, image,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()),
+                         regions.data());
 
   vkinit::endSingleTimeCommands(commandBuffer, _graphicsQueue, _device,
                                 _commandPool);
 }
 
 void VulkanEngine::createTextureImageView(VkImage &textureImage,
-                                          VkImageView &textureImageView) {
-  textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB);
+                                          VkImageView &textureImageView,
+                                          VkFormat format,
+                                          uint32_t mipLevels) {
+  textureImageView = createImageView(textureImage, format, mipLevels);
 }
 
-VkImageView VulkanEngine::createImageView(VkImage image, VkFormat format) {
+VkImageView VulkanEngine::createImageView(VkImage image, VkFormat format,
+                                          uint32_t mipLevels,
+                                          VkImageAspectFlags aspect) {
 
   VkImageView imageView;
 
@@ -1365,9 +3032,9 @@ VkImageView VulkanEngine::createImageView(VkImage image, VkFormat format) {
   viewInfo.image = image;
   viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
   viewInfo.format = format;
-  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.aspectMask = aspect;
   viewInfo.subresourceRange.baseMipLevel = 0;
-  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = 1;
 
@@ -1387,7 +3054,8 @@ void VulkanEngine::createImageViews() {
   }
 }
 
-void VulkanEngine::createTextureSampler(VkSampler &textureSampler) {
+void VulkanEngine::createTextureSampler(VkSampler &textureSampler,
+                                        uint32_t mipLevels) {
 
   VkPhysicalDeviceProperties properties{};
   vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
@@ -1408,7 +3076,7 @@ void VulkanEngine::createTextureSampler(VkSampler &textureSampler) {
   samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
   samplerInfo.mipLodBias = 0.0f;
   samplerInfo.minLod = 0.0f;
-  samplerInfo.maxLod = 0.0f;
+  samplerInfo.maxLod = static_cast<float>(mipLevels);
 
   if (vkCreateSampler(_device, &samplerInfo, nullptr, &textureSampler) !=
       VK_SUCCESS) {
@@ -1416,7 +3084,7 @@ void VulkanEngine::createTextureSampler(VkSampler &textureSampler) {
   }
 };
 
-void VulkanEngine::createMeshDescriptorSet(Mesh &mesh) {
+void VulkanEngine::createTextureDescriptorSet(Texture &texture) {
 
   if (_descriptorPool == VK_NULL_HANDLE) {
     throw std::runtime_error("Descriptor pool is VK_NULL_HANDLE");
@@ -1424,11 +3092,11 @@ void VulkanEngine::createMeshDescriptorSet(Mesh &mesh) {
   if (_descriptorSetLayout == VK_NULL_HANDLE) {
     throw std::runtime_error("Descriptor set layout is VK_NULL_HANDLE");
   }
-  if (mesh.textureImageView == VK_NULL_HANDLE) {
-    throw std::runtime_error("Mesh texture image view is VK_NULL_HANDLE");
+  if (texture.view == VK_NULL_HANDLE) {
+    throw std::runtime_error("Texture image view is VK_NULL_HANDLE");
   }
-  if (mesh.textureSampler == VK_NULL_HANDLE) {
-    throw std::runtime_error("Mesh texture sampler is VK_NULL_HANDLE");
+  if (texture.sampler == VK_NULL_HANDLE) {
+    throw std::runtime_error("Texture sampler is VK_NULL_HANDLE");
   }
 
   VkDescriptorSetAllocateInfo allocInfo{};
@@ -1438,9 +3106,9 @@ void VulkanEngine::createMeshDescriptorSet(Mesh &mesh) {
   allocInfo.pSetLayouts = &_descriptorSetLayout;
 
   VkResult result =
-      vkAllocateDescriptorSets(_device, &allocInfo, &mesh.descriptorSet);
+      vkAllocateDescriptorSets(_device, &allocInfo, &texture.descriptorSet);
   if (result != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate mesh descriptor set, error: " +
+    throw std::runtime_error("failed to allocate texture descriptor set, error: " +
                              std::to_string(result));
   }
 
@@ -1452,13 +3120,13 @@ void VulkanEngine::createMeshDescriptorSet(Mesh &mesh) {
 
   VkDescriptorImageInfo imageInfo{};
   imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  imageInfo.imageView = mesh.textureImageView;
-  imageInfo.sampler = mesh.textureSampler;
+  imageInfo.imageView = texture.view;
+  imageInfo.sampler = texture.sampler;
 
   std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
 
   descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  descriptorWrites[0].dstSet = mesh.descriptorSet;
+  descriptorWrites[0].dstSet = texture.descriptorSet;
   descriptorWrites[0].dstBinding = 0;
   descriptorWrites[0].dstArrayElement = 0;
   descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -1466,7 +3134,7 @@ void VulkanEngine::createMeshDescriptorSet(Mesh &mesh) {
   descriptorWrites[0].pBufferInfo = &bufferInfo;
 
   descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  descriptorWrites[1].dstSet = mesh.descriptorSet;
+  descriptorWrites[1].dstSet = texture.descriptorSet;
   descriptorWrites[1].dstBinding = 1;
   descriptorWrites[1].dstArrayElement = 0;
   descriptorWrites[1].descriptorType =
@@ -1479,66 +3147,836 @@ void VulkanEngine::createMeshDescriptorSet(Mesh &mesh) {
                          descriptorWrites.data(), 0, nullptr);
 }
 
-void VulkanEngine::createTilemapMesh(const Tilemap &tilemap,
-                                     const char *texturePath) {
+void VulkanEngine::createTilemap(Tilemap tilemap, const char *texturePath) {
+  _worldMap = std::move(tilemap);
+  // the first upload or chunk build reads the current tiles anyway
+  _worldMap.clearDirty();
+  _tileChunkLoaded.clear();
+  _mapFile.close();
+  if (_tileEditStaging.empty()) {
+    _tileEditStaging.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    _tileEditStagingMemory.assign(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    _tileEditStagingMapped.assign(MAX_FRAMES_IN_FLIGHT, nullptr);
+    _tileEditStagingCapacity.assign(MAX_FRAMES_IN_FLIGHT, 0);
+  }
+  _tileChunks.assign(
+      static_cast<size_t>(_worldMap.chunksX()) * _worldMap.chunksY(), {});
+  _tileChunkBuilds.clear();
+  _tileChunksBuilt = 0;
+  _tileTextureId = requestTexture(texturePath);
+
+  destroyGpuTilemap();
+  if (_gpuTilemap) {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+    uint32_t maxSize = properties.limits.maxImageDimension2D;
+    if (_worldMap.width() == 0 || _worldMap.height() == 0 ||
+        static_cast<uint32_t>(_worldMap.width()) > maxSize ||
+        static_cast<uint32_t>(_worldMap.height()) > maxSize) {
+      std::cout << "tilemap: " << _worldMap.width() << "x"
+                << _worldMap.height() << " does not fit a " << maxSize
+                << " image, drawing mesh chunks\n";
+      _gpuTilemap = false;
+    }
+  }
+  if (_gpuTilemap) {
+    createGpuTilemap();
+  } else {
+    createTileChunkPool();
+  }
+}
+
+void VulkanEngine::createGpuTilemap() {
+  const auto &layout = _layoutCache.get(
+      {embeddedShaders::tilemap_vert, embeddedShaders::tilemap_frag});
+  if (layout.pushConstants.size != sizeof(TilemapPushConstants)) {
+    throw std::runtime_error("tilemap shader push constants do not match "
+                             "TilemapPushConstants");
+  }
+  _tilemapPipelineLayout = layout.layout;
 
-  std::vector<vertexData::Vertex> vertices;
-  std::vector<uint16_t> indices;
+  // Tile is a bare uint16_t, so the map's storage is the texel data
+  uint32_t width = static_cast<uint32_t>(_worldMap.width());
+  uint32_t height = static_cast<uint32_t>(_worldMap.height());
+  VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height *
+                           sizeof(Tile);
+
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingBufferMemory;
+  createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               stagingBuffer, stagingBufferMemory);
+
+  void *data;
+  vkMapMemory(_device, stagingBufferMemory, 0, imageSize, 0, &data);
+  memcpy(data, _worldMap.data(), static_cast<size_t>(imageSize));
+  vkUnmapMemory(_device, stagingBufferMemory);
+
+  createImage(width, height, VK_FORMAT_R16_UINT, VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _tileIndexImage,
+              _tileIndexMemory);
+  vkinit::transitionImageLayout(_tileIndexImage, VK_IMAGE_LAYOUT_UNDEFINED,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                _commandPool, _device, _graphicsQueue);
+  copyBufferToImage(stagingBuffer, _tileIndexImage, width, height);
+  vkinit::transitionImageLayout(_tileIndexImage,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                _commandPool, _device, _graphicsQueue);
+
+  vkDestroyBuffer(_device, stagingBuffer, nullptr);
+  vkFreeMemory(_device, stagingBufferMemory, nullptr);
+
+  _tileIndexView = createImageView(_tileIndexImage, VK_FORMAT_R16_UINT);
+
+  // integer formats cannot be filtered, the shader uses texelFetch anyway
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  if (vkCreateSampler(_device, &samplerInfo, nullptr, &_tileIndexSampler) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create tile index sampler");
+  }
+
+  std::vector<VkDescriptorSetLayout> setLayouts(MAX_FRAMES_IN_FLIGHT,
+                                                layout.setLayouts[0]);
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = _descriptorPool;
+  allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+  allocInfo.pSetLayouts = setLayouts.data();
+
+  _tilemapSets.resize(MAX_FRAMES_IN_FLIGHT);
+  if (vkAllocateDescriptorSets(_device, &allocInfo, _tilemapSets.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate tilemap descriptor sets");
+  }
+
+  // the atlas starts as the placeholder, see drawGpuTilemap
+  _tilemapSetAtlas.assign(MAX_FRAMES_IN_FLIGHT, _placeholderTexture.view);
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = _uniformBuffers[i];
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(UniformBufferObject);
+
+    VkDescriptorImageInfo atlasInfo{};
+    atlasInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    atlasInfo.imageView = _placeholderTexture.view;
+    atlasInfo.sampler = _placeholderTexture.sampler;
+
+    VkDescriptorImageInfo indexInfo{};
+    indexInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    indexInfo.imageView = _tileIndexView;
+    indexInfo.sampler = _tileIndexSampler;
+
+    std::array<VkWriteDescriptorSet, 3> writes{};
+    for (uint32_t binding = 0; binding < writes.size(); binding++) {
+      writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[binding].dstSet = _tilemapSets[i];
+      writes[binding].dstBinding = binding;
+      writes[binding].descriptorCount = 1;
+      writes[binding].descriptorType =
+          VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    }
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    writes[0].pBufferInfo = &bufferInfo;
+    writes[1].pImageInfo = &atlasInfo;
+    writes[2].pImageInfo = &indexInfo;
+    vkUpdateDescriptorSets(_device, static_cast<uint32_t>(writes.size()),
+                           writes.data(), 0, nullptr);
+  }
+
+  // no vertex input, the quad comes from gl_VertexIndex
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  vertexInputInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  _tilemapPipeline = _pipelineRegistry.declare(
+      pipelineDesc(embeddedShaders::tilemap_vert,
+                   embeddedShaders::tilemap_frag, vertexInputInfo, false));
+
+  std::cout << "tilemap: " << width << "x" << height << " index texture, "
+            << imageSize / 1024 << " KiB\n";
+}
+
+void VulkanEngine::destroyGpuTilemap() {
+  if (!_tilemapSets.empty()) {
+    vkFreeDescriptorSets(_device, _descriptorPool,
+                         static_cast<uint32_t>(_tilemapSets.size()),
+                         _tilemapSets.data());
+    _tilemapSets.clear();
+    _tilemapSetAtlas.clear();
+  }
+  if (_tileIndexSampler != VK_NULL_HANDLE) {
+    vkDestroySampler(_device, _tileIndexSampler, nullptr);
+    _tileIndexSampler = VK_NULL_HANDLE;
+  }
+  if (_tileIndexView != VK_NULL_HANDLE) {
+    vkDestroyImageView(_device, _tileIndexView, nullptr);
+    _tileIndexView = VK_NULL_HANDLE;
+  }
+  if (_tileIndexImage != VK_NULL_HANDLE) {
+    vkDestroyImage(_device, _tileIndexImage, nullptr);
+    _tileIndexImage = VK_NULL_HANDLE;
+  }
+  if (_tileIndexMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, _tileIndexMemory, nullptr);
+    _tileIndexMemory = VK_NULL_HANDLE;
+  }
+}
+
+void VulkanEngine::drawGpuTilemap(VkCommandBuffer commandBuffer,
+                                  uint32_t currentFrame) {
+  if (_tilemapSets.empty()) {
+    return;
+  }
+
+  // the view clipped to the map, tiles are centred on integer coordinates
+  glm::vec4 rect = cameraRect();
+  rect.x = std::max(rect.x, -0.5f);
+  rect.y = std::max(rect.y, -0.5f);
+  rect.z = std::min(rect.z, _worldMap.width() - 0.5f);
+  rect.w = std::min(rect.w, _worldMap.height() - 0.5f);
+  if (rect.x >= rect.z || rect.y >= rect.w) {
+    return;
+  }
+
+  VkPipeline pipeline = _pipelineRegistry.request(_tilemapPipeline);
+  if (pipeline == VK_NULL_HANDLE) {
+    return;
+  }
+
+  // this frame's fence has been waited on, its set can be rewritten
+  const Texture &tileTexture = _textures[_tileTextureId];
+  const Texture &atlas =
+      tileTexture.resident ? tileTexture : _placeholderTexture;
+  if (_tilemapSetAtlas[currentFrame] != atlas.view) {
+    VkDescriptorImageInfo atlasInfo{};
+    atlasInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    atlasInfo.imageView = atlas.view;
+    atlasInfo.sampler = atlas.sampler;
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = _tilemapSets[currentFrame];
+    write.dstBinding = 1;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &atlasInfo;
+    vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+    _tilemapSetAtlas[currentFrame] = atlas.view;
+  }
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          _tilemapPipelineLayout, 0, 1,
+                          &_tilemapSets[currentFrame], 0, nullptr);
+
+  // same atlas layout as the mesh chunks, see tilemapMesh::buildChunk
+  TilemapPushConstants push{};
+  push.rect = rect;
+  push.atlasColumns = 1;
+  push.atlasRows = 1;
+  push.depth = layerDepth(0);
+  vkCmdPushConstants(commandBuffer, _tilemapPipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT |
+                         VK_SHADER_STAGE_FRAGMENT_BIT,
+                     0, sizeof(push), &push);
+
+  vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+  _drawStats.tilemapDraws++;
+}
+
+void VulkanEngine::createTileChunkPool() {
+  // slots are handed out again from scratch for a new map
+  _tileChunkFreeSlots.clear();
+  for (uint32_t slot = maxTileChunkSlots; slot > 0; slot--) {
+    _tileChunkFreeSlots.push_back(slot - 1);
+  }
+  _tileChunkSlotOwner.assign(maxTileChunkSlots, 0);
+  _tileChunksStarved = false;
+  if (_tileChunkPool != VK_NULL_HANDLE) {
+    return;
+  }
+
+  createBuffer(tileChunkIndexBytes + tileChunkVertexBytes * maxTileChunkSlots,
+               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                   VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, _tileChunkPool,
+               _tileChunkPoolMemory);
+
+  // every chunk is quads in the same order, one index list serves them all;
+  // 32x32 tiles always fit 16-bit indices
+  std::vector<uint16_t> quadIndices;
+  quadIndices.reserve(tileChunkQuads * 6);
+  for (uint32_t quad = 0; quad < tileChunkQuads; quad++) {
+    uint16_t base = static_cast<uint16_t>(quad * 4);
+    for (uint16_t corner : {0, 1, 2, 0, 2, 3}) {
+      quadIndices.push_back(static_cast<uint16_t>(base + corner));
+    }
+  }
+  uploadToBuffer(quadIndices.data(), sizeof(uint16_t) * quadIndices.size(),
+                 _tileChunkPool);
+}
+
+void VulkanEngine::destroyTileChunkPool() {
+  if (_tileChunkPool != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, _tileChunkPool, nullptr);
+    _tileChunkPool = VK_NULL_HANDLE;
+  }
+  if (_tileChunkPoolMemory != VK_NULL_HANDLE) {
+    vkFreeMemory(_device, _tileChunkPoolMemory, nullptr);
+    _tileChunkPoolMemory = VK_NULL_HANDLE;
+  }
+  _tileChunkFreeSlots.clear();
+  _tileChunkSlotOwner.clear();
+}
 
-  float tileSize = 1.0f;
-  int atlasColums = 1;
-  int atlasRows = 1;
+VkDeviceSize VulkanEngine::tileChunkSlotOffset(uint32_t slot) const {
+  return tileChunkIndexBytes + tileChunkVertexBytes * slot;
+}
+
+uint32_t VulkanEngine::acquireTileChunkSlot() {
+  if (!_tileChunkFreeSlots.empty()) {
+    uint32_t slot = _tileChunkFreeSlots.back();
+    _tileChunkFreeSlots.pop_back();
+    return slot;
+  }
+
+  // the least recently visible chunk that is out of view this frame; frames
+  // in flight may still draw it, the copy barrier waits for them
+  uint32_t victim = noTileChunkSlot;
+  uint64_t oldest = _tileFrame;
+  for (uint32_t slot = 0; slot < maxTileChunkSlots; slot++) {
+    const TileChunk &owner = _tileChunks[_tileChunkSlotOwner[slot]];
+    if (owner.lastVisible < oldest) {
+      oldest = owner.lastVisible;
+      victim = slot;
+    }
+  }
+  if (victim == noTileChunkSlot) {
+    return noTileChunkSlot;
+  }
+
+  TileChunk &evicted = _tileChunks[_tileChunkSlotOwner[victim]];
+  evicted.built = false;
+  evicted.slot = noTileChunkSlot;
+  evicted.mesh.indexCount = 0;
+  _tileChunksBuilt--;
+  return victim;
+}
+
+void VulkanEngine::updateTileChunks() {
+  if (_gpuTilemap || _tileChunks.empty()) {
+    return;
+  }
+  _tileFrame++;
+
+  // one chunk of margin, so meshes are uploaded before they scroll in
+  glm::vec4 rect = cameraRect() +
+                   glm::vec4(-tileChunkSize, -tileChunkSize, tileChunkSize,
+                             tileChunkSize);
+  int firstX, lastX, firstY, lastY;
+  tileChunkRange(rect, firstX, lastX, firstY, lastY);
+
+  for (int chunkY = firstY; chunkY <= lastY; chunkY++) {
+    for (int chunkX = firstX; chunkX <= lastX; chunkX++) {
+      uint32_t index =
+          static_cast<uint32_t>(chunkY * _worldMap.chunksX() + chunkX);
+      TileChunk &chunk = _tileChunks[index];
+      chunk.lastVisible = _tileFrame;
+      if (!chunk.built && !chunk.queued) {
+        chunk.queued = true;
+        _tileChunkBuilds.push_back(index);
+      }
+    }
+  }
+}
 
-  glm::vec3 tileColor(1.0f, 1.0f, 1.0f);
+void VulkanEngine::drawTileChunks(VkCommandBuffer commandBuffer,
+                                  glm::vec4 viewRect) {
+  if (_gpuTilemap || _tileChunks.empty()) {
+    return;
+  }
 
-  for (int y = 0; y < tilemap.height; y++) {
-    for (int x = 0; x < tilemap.width; x++) {
-      Tile tile = tilemap.getTile(x, y);
-      if (tile.type == 0)
+  // only the chunks under the camera are visited, however big the map is;
+  // ones still waiting for their upload are skipped
+  int firstX, lastX, firstY, lastY;
+  tileChunkRange(viewRect, firstX, lastX, firstY, lastY);
+  bool bound = false;
+
+  for (int chunkY = firstY; chunkY <= lastY; chunkY++) {
+    for (int chunkX = firstX; chunkX <= lastX; chunkX++) {
+      const TileChunk &chunk =
+          _tileChunks[chunkY * _worldMap.chunksX() + chunkX];
+      const Mesh &mesh = chunk.mesh;
+      if (!chunk.built || mesh.indexCount == 0) {
         continue;
+      }
+
+      // every chunk has the tile atlas and the pool buffer
+      if (!bound) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          meshPipeline(meshVariant(mesh), false));
+        VkDescriptorSet descriptorSet = textureDescriptorSet(mesh.textureId);
+        vkCmdBindDescriptorSets(commandBuffer,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                _pipelineLayout, 0, 1, &descriptorSet, 0,
+                                nullptr);
+        VkBuffer vertexBuffers[] = {mesh.vertexBuffer};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0,
+                             mesh.indexType);
+        bound = true;
+        _drawStats.binds += 4;
+        _drawStats.unsortedBinds += 4;
+      }
+
+      SpritePushConstants push{};
+      push.model = mesh.transform;
+      push.atlasColumns = mesh.animation.columns;
+      push.atlasRows = mesh.animation.rows;
+      push.baseFrame = mesh.animation.baseFrame;
+      push.frameCount = mesh.animation.frameCount;
+      push.fps = mesh.animation.fps;
+      push.startTime = mesh.animation.startTime;
+      push.loop = mesh.animation.loop ? 1 : 0;
+      push.depth = layerDepth(mesh.layer);
+      vkCmdPushConstants(commandBuffer, _pipelineLayout,
+                         VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+
+      vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, mesh.firstIndex,
+                       mesh.vertexOffset, 0);
+      _drawStats.tileChunks++;
+      _drawStats.meshDraws++;
+    }
+  }
+}
+
+void VulkanEngine::tileChunkRange(glm::vec4 rect, int &firstX, int &lastX,
+                                  int &firstY, int &lastY) const {
+  // tiles are centred on integer coordinates, so chunk c covers
+  // [c * size - 0.5, (c + 1) * size - 0.5)
+  auto range = [](float lo, float hi, int count, int &first, int &last) {
+    first = static_cast<int>(std::floor((lo + 0.5f) / tileChunkSize));
+    last = static_cast<int>(std::floor((hi + 0.5f) / tileChunkSize));
+    first = std::max(first, 0);
+    last = std::min(last, count - 1);
+  };
+  range(rect.x, rect.z, _worldMap.chunksX(), firstX, lastX);
+  range(rect.y, rect.w, _worldMap.chunksY(), firstY, lastY);
+}
+
+bool VulkanEngine::loadMap(const std::string &path) {
+  texfile::MappedFile file;
+  mapfile::MapView view;
+  // chunks are read in whatever order the camera visits them
+  if (!file.open(path, false) || !mapfile::parse(file, view)) {
+    return false;
+  }
+
+  // starts empty, chunks fill in as they are streamed
+  createTilemap(Tilemap(static_cast<int>(view.header->width),
+                        static_cast<int>(view.header->height)),
+                "../textures/grass.jpg");
+  _mapFile = std::move(file);
+  _mapView = view;
+  _tileChunkLoaded.assign(view.header->chunkCount, 0);
+  _tileChunksLoaded = 0;
+
+  std::cout << "map " << path << ": " << view.header->width << "x"
+            << view.header->height << ", " << _mapFile.size() / 1024
+            << " KiB mapped\n";
+  return true;
+}
 
-      float u1 = (float)((tile.type - 1) % atlasColums) / atlasColums;
-      float v1 = (float)((tile.type - 1) / atlasColums) / atlasRows;
-      float u2 = u1 + 1.0f / atlasColums;
-      float v2 = v1 + 1.0f / atlasRows;
+void VulkanEngine::streamTileChunks() {
+  if (_tileChunkLoaded.empty()) {
+    return;
+  }
 
-      glm::vec2 pos1(x * tileSize - 0.5f, y * tileSize - 0.5f);
-      glm::vec2 pos2((x + 1) * tileSize - 0.5f, y * tileSize - 0.5f);
-      glm::vec2 pos3((x + 1) * tileSize - 0.5f, (y + 1) * tileSize - 0.5f);
-      glm::vec2 pos4(x * tileSize - 0.5f, (y + 1) * tileSize - 0.5f);
+  // one chunk of margin, so chunks are in place before they scroll in
+  glm::vec4 rect = cameraRect() +
+                   glm::vec4(-tileChunkSize, -tileChunkSize, tileChunkSize,
+                             tileChunkSize);
+  int firstX, lastX, firstY, lastY;
+  tileChunkRange(rect, firstX, lastX, firstY, lastY);
+
+  for (int chunkY = firstY; chunkY <= lastY; chunkY++) {
+    for (int chunkX = firstX; chunkX <= lastX; chunkX++) {
+      uint32_t index =
+          static_cast<uint32_t>(chunkY * _worldMap.chunksX() + chunkX);
+      if (_tileChunkLoaded[index] != 0) {
+        continue;
+      }
+      decodeMapChunk(index);
+      _tileChunkLoaded[index] = 1;
+      _tileChunksLoaded++;
+    }
+  }
 
-      uint16_t baseIndex = static_cast<uint16_t>(vertices.size());
+  if (_tileChunksLoaded == _tileChunkLoaded.size()) {
+    finishMapStreaming();
+  }
+}
 
-      vertices.push_back({pos1, tileColor, {u1, v1}});
-      vertices.push_back({pos2, tileColor, {u2, v1}});
-      vertices.push_back({pos3, tileColor, {u2, v2}});
-      vertices.push_back({pos4, tileColor, {u1, v2}});
+void VulkanEngine::decodeMapChunk(uint32_t index) {
+  int chunkX = static_cast<int>(index) % _worldMap.chunksX();
+  int chunkY = static_cast<int>(index) / _worldMap.chunksX();
+  if (!mapfile::decodeChunk(_mapView, index, _worldMap)) {
+    std::cout << "map chunk " << chunkX << "," << chunkY
+              << " is corrupt, left empty\n";
+  }
+  // uploaded as an edit, or built from these tiles once in view
+  _worldMap.markDirty(chunkX * tileChunkSize, chunkY * tileChunkSize,
+                      tileChunkSize, tileChunkSize);
+}
 
-      indices.push_back(baseIndex);
-      indices.push_back(static_cast<uint16_t>(baseIndex + 1));
-      indices.push_back(static_cast<uint16_t>(baseIndex + 2));
-      indices.push_back(baseIndex);
-      indices.push_back(static_cast<uint16_t>(baseIndex + 2));
-      indices.push_back(static_cast<uint16_t>(baseIndex + 3));
+void VulkanEngine::finishMapStreaming() {
+  for (uint32_t index = 0; index < _tileChunkLoaded.size(); index++) {
+    if (_tileChunkLoaded[index] == 0) {
+      decodeMapChunk(index);
     }
   }
+  _tileChunkLoaded.clear();
+  _mapView = {};
+  _mapFile.close();
+}
 
-  if (!vertices.empty()) {
-    createMesh(vertices, indices, glm::mat4(1.0f), glm::vec3(0.0f), texturePath,
-               false);
+bool VulkanEngine::saveMap(const std::string &path) {
+  // unloaded chunks would be saved empty, and the file may be the one
+  // still mapped
+  finishMapStreaming();
+
+  std::error_code error;
+  std::filesystem::path parent = std::filesystem::path(path).parent_path();
+  if (!parent.empty()) {
+    std::filesystem::create_directories(parent, error);
+  }
+  if (!mapfile::write(path, _worldMap)) {
+    std::cout << "failed to save map " << path << "\n";
+    return false;
   }
+  std::cout << "map saved to " << path << "\n";
+  return true;
 }
 
 void VulkanEngine::createMap() {
-  int width = 10;
-  int height = 10;
+  if (loadMap(_mapPath)) {
+    return;
+  }
+
+  // no saved world yet, "Save map" writes this one to _mapPath
+  int width = mapfile::maxMapSize;
+  int height = mapfile::maxMapSize;
   Tilemap worldMap(width, height);
+  worldMap.fill(1);
+
+  createTilemap(std::move(worldMap), "../textures/grass.jpg");
+}
+
+void VulkanEngine::reserveTileEditStaging(uint32_t frame, VkDeviceSize size) {
+  if (_tileEditStagingCapacity[frame] >= size) {
+    return;
+  }
+
+  VkDeviceSize capacity = std::max({size, _tileEditStagingCapacity[frame] * 2,
+                                    VkDeviceSize(64 * 1024)});
+  destroyTileEditStaging(frame);
+
+  createBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               _tileEditStaging[frame], _tileEditStagingMemory[frame]);
+  vkMapMemory(_device, _tileEditStagingMemory[frame], 0, capacity, 0,
+              &_tileEditStagingMapped[frame]);
+  _tileEditStagingCapacity[frame] = capacity;
+}
+
+void VulkanEngine::destroyTileEditStaging(uint32_t frame) {
+  if (_tileEditStagingMemory[frame] != VK_NULL_HANDLE) {
+    vkUnmapMemory(_device, _tileEditStagingMemory[frame]);
+    vkFreeMemory(_device, _tileEditStagingMemory[frame], nullptr);
+    _tileEditStagingMemory[frame] = VK_NULL_HANDLE;
+  }
+  if (_tileEditStaging[frame] != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, _tileEditStaging[frame], nullptr);
+    _tileEditStaging[frame] = VK_NULL_HANDLE;
+  }
+  _tileEditStagingMapped[frame] = nullptr;
+  _tileEditStagingCapacity[frame] = 0;
+}
+
+void VulkanEngine::flushTileEdits(VkCommandBuffer commandBuffer,
+                                  uint32_t currentFrame) {
+  if (_tileEditStaging.empty()) {
+    return;
+  }
 
-  for (int y = 0; y < height; y++) {
-    for (int x = 0; x < width; x++) {
-      worldMap.setTile(x, y, 1);
+  if (_gpuTilemap) {
+    if (_worldMap.dirtyCount() != 0) {
+      flushTileTexels(commandBuffer, currentFrame);
     }
+  } else if (_worldMap.dirtyCount() != 0 || !_tileChunkBuilds.empty()) {
+    flushTileVertices(commandBuffer, currentFrame);
   }
+}
+
+void VulkanEngine::flushTileTexels(VkCommandBuffer commandBuffer,
+                                   uint32_t currentFrame) {
+  // a region is at most one chunk of 2-byte texels, a full map refill
+  // spreads over several frames
+  const VkDeviceSize chunkBytes = tileChunkSize * tileChunkSize * sizeof(Tile);
+  _tileEditRegions.clear();
+  _worldMap.takeDirty(_tileEditRegions, maxTileEditBytesPerFrame / chunkBytes);
+
+  VkDeviceSize size = 0;
+  for (const auto &region : _tileEditRegions) {
+    size += static_cast<VkDeviceSize>(region.w) * region.h * sizeof(Tile);
+  }
+  reserveTileEditStaging(currentFrame, size);
+
+  // rows packed tightly, one copy region per dirty rectangle
+  auto *staging = static_cast<uint8_t *>(_tileEditStagingMapped[currentFrame]);
+  std::vector<VkBufferImageCopy> copies;
+  copies.reserve(_tileEditRegions.size());
+  VkDeviceSize offset = 0;
+  for (const auto &region : _tileEditRegions) {
+    VkBufferImageCopy copy{};
+    copy.bufferOffset = offset;
+    copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.imageSubresource.layerCount = 1;
+    copy.imageOffset = {region.x, region.y, 0};
+    copy.imageExtent = {static_cast<uint32_t>(region.w),
+                        static_cast<uint32_t>(region.h), 1};
+    copies.push_back(copy);
+
+    for (int y = region.y; y < region.y + region.h; y++) {
+      size_t rowBytes = region.w * sizeof(Tile);
+      memcpy(staging + offset, _worldMap.row(y) + region.x, rowBytes);
+      offset += rowBytes;
+    }
+  }
+
+  // frames still in flight may be sampling the image, the barrier waits
+  // for their fragment shaders
+  vkinit::transitionImage(commandBuffer, _tileIndexImage,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  vkCmdCopyBufferToImage(commandBuffer, _tileEditStaging[currentFrame],
+                         _tileIndexImage,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(copies.size()), copies.data());
+  vkinit::transitionImage(commandBuffer, _tileIndexImage,
+                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+  _drawStats.tileEditRegions = static_cast<uint32_t>(copies.size());
+  _drawStats.tileEditBytes = size;
+}
+
+void VulkanEngine::flushTileVertices(VkCommandBuffer commandBuffer,
+                                     uint32_t currentFrame) {
+  // worst case a whole chunk of vertices per region or build
+  _tileEditRegions.clear();
+  _worldMap.takeDirty(_tileEditRegions,
+                      maxTileEditBytesPerFrame / tileChunkVertexBytes);
+  size_t builds = std::min<size_t>(_tileChunkBuilds.size(),
+                                   maxTileChunkBuildsPerFrame);
+  reserveTileEditStaging(currentFrame, tileChunkVertexBytes *
+                                           (_tileEditRegions.size() + builds));
+
+  auto *staging = static_cast<uint8_t *>(_tileEditStagingMapped[currentFrame]);
+  VkDeviceSize offset = 0;
+  std::vector<VkBufferCopy> copies;
+  std::vector<uint32_t> builtNow;
+  std::vector<vertexData::Vertex> vertices;
+  std::vector<uint32_t> indices;
+
+  // queued builds first, oldest first, so a slot taken from an evicted chunk
+  // never also receives that chunk's edits. A chunk that scrolled away while
+  // it waited is dropped and queued again when it comes back.
+  size_t taken = 0;
+  for (; taken < _tileChunkBuilds.size() && builtNow.size() < builds;
+       taken++) {
+    uint32_t index = _tileChunkBuilds[taken];
+    TileChunk &chunk = _tileChunks[index];
+    chunk.queued = false;
+    if (chunk.built || chunk.lastVisible != _tileFrame) {
+      continue;
+    }
+    int chunkX = static_cast<int>(index) % _worldMap.chunksX();
+    int chunkY = static_cast<int>(index) / _worldMap.chunksX();
+
+    vertices.clear();
+    indices.clear();
+    tilemapMesh::buildChunk(_worldMap, chunkX, chunkY, 1, 1, vertices,
+                            indices);
+    uint32_t slot = noTileChunkSlot;
+    if (!vertices.empty()) {
+      slot = acquireTileChunkSlot();
+      if (slot == noTileChunkSlot) {
+        // every slot is in view, try again next frame
+        if (!_tileChunksStarved) {
+          std::cout << "all " << maxTileChunkSlots
+                    << " tile chunk slots hold visible chunks, "
+                    << _tileChunkBuilds.size() - taken
+                    << " chunk builds wait\n";
+          _tileChunksStarved = true;
+        }
+        chunk.queued = true;
+        break;
+      }
+      _tileChunkSlotOwner[slot] = index;
+    }
+
+    // vertices are relative to the chunk origin, which keeps the half float
+    // positions exact on any map size; bounds cover every tile so edits
+    // never move them
+    Mesh &mesh = chunk.mesh;
+    mesh.vertexBuffer = _tileChunkPool;
+    mesh.indexBuffer = _tileChunkPool;
+    mesh.indexType = VK_INDEX_TYPE_UINT16;
+    mesh.indexCount = static_cast<uint32_t>(vertices.size() / 4 * 6);
+    mesh.textureId = _tileTextureId;
+    mesh.layer = 0;
+    mesh.transform = glm::mat3x2(
+        glm::vec2(1.0f, 0.0f), glm::vec2(0.0f, 1.0f),
+        glm::vec2(chunkX * tileChunkSize, chunkY * tileChunkSize));
+    mesh.localBounds = glm::vec4(-0.5f, -0.5f, tileChunkSize - 0.5f,
+                                 tileChunkSize - 0.5f);
+    mesh.updateBounds();
+    chunk.slot = slot;
+    chunk.built = true;
+    _tileChunksBuilt++;
+    builtNow.push_back(index);
+
+    if (slot == noTileChunkSlot) {
+      continue;
+    }
+    mesh.vertexOffset = static_cast<int32_t>(tileChunkSlotOffset(slot) /
+                                             sizeof(vertexData::Vertex));
+    VkDeviceSize bytes = sizeof(vertexData::Vertex) * vertices.size();
+    memcpy(staging + offset, vertices.data(), bytes);
+
+    VkBufferCopy copy{};
+    copy.srcOffset = offset;
+    copy.dstOffset = tileChunkSlotOffset(slot);
+    copy.size = bytes;
+    copies.push_back(copy);
+    offset += bytes;
+  }
+  _tileChunkBuilds.erase(_tileChunkBuilds.begin(),
+                         _tileChunkBuilds.begin() + taken);
+
+  for (const auto &region : _tileEditRegions) {
+    // unbuilt chunks read the current tiles when they are built, and so did
+    // the ones just built
+    TileChunk &chunk = _tileChunks[region.chunk];
+    if (!chunk.built ||
+        std::find(builtNow.begin(), builtNow.end(),
+                  static_cast<uint32_t>(region.chunk)) != builtNow.end()) {
+      continue;
+    }
+    int chunkX = region.chunk % _worldMap.chunksX();
+    int chunkY = region.chunk / _worldMap.chunksX();
+
+    vertices.clear();
+    indices.clear();
+    tilemapMesh::buildChunk(_worldMap, chunkX, chunkY, 1, 1, vertices,
+                            indices);
+    uint32_t quads = static_cast<uint32_t>(vertices.size() / 4);
+    if (chunk.slot == noTileChunkSlot) {
+      // had no tiles when built, needs a slot now
+      if (quads > 0) {
+        chunk.built = false;
+        _tileChunksBuilt--;
+      }
+      continue;
+    }
+
+    // tiles before the region keep their quads; unless a tile appeared or
+    // vanished, so do the ones after it
+    uint32_t firstQuad = static_cast<uint32_t>(
+        tilemapMesh::quadsBefore(_worldMap, chunkX, chunkY, region.x,
+                                 region.y));
+    uint32_t endQuad = quads;
+    if (!region.shapeChanged) {
+      int lastX = region.x + region.w - 1;
+      int lastY = region.y + region.h - 1;
+      endQuad = static_cast<uint32_t>(
+          tilemapMesh::quadsBefore(_worldMap, chunkX, chunkY, lastX, lastY) +
+          (_worldMap.at(lastX, lastY).type != 0 ? 1 : 0));
+    }
+    chunk.mesh.indexCount = quads * 6;
+
+    if (endQuad > firstQuad) {
+      VkDeviceSize bytes =
+          sizeof(vertexData::Vertex) * 4 * (endQuad - firstQuad);
+      memcpy(staging + offset, vertices.data() + firstQuad * 4, bytes);
+
+      VkBufferCopy copy{};
+      copy.srcOffset = offset;
+      copy.dstOffset = tileChunkSlotOffset(chunk.slot) +
+                       sizeof(vertexData::Vertex) * 4 * firstQuad;
+      copy.size = bytes;
+      copies.push_back(copy);
+      offset += bytes;
+    }
+  }
+
+  if (copies.empty()) {
+    return;
+  }
+
+  // earlier frames may still be reading the pool
+  VkMemoryBarrier before{};
+  before.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  before.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0,
+                       nullptr, 0, nullptr);
+
+  vkCmdCopyBuffer(commandBuffer, _tileEditStaging[currentFrame],
+                  _tileChunkPool, static_cast<uint32_t>(copies.size()),
+                  copies.data());
+
+  VkMemoryBarrier after{};
+  after.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  after.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &after, 0,
+                       nullptr, 0, nullptr);
+
+  _drawStats.tileEditRegions = static_cast<uint32_t>(copies.size());
+  _drawStats.tileEditBytes = offset;
+}
 
-  createTilemapMesh(worldMap, "../textures/grass.jpg");
+void VulkanEngine::updateStressTileEdits() {
+  if (_stressTileEdits <= 0 || _worldMap.width() == 0) {
+    return;
+  }
+
+  // punch holes and fill them again under the camera, half the edits change
+  // the shape of a chunk mesh
+  glm::vec4 view = cameraRect();
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (int i = 0; i < _stressTileEdits; i++) {
+    float worldX = view.x + (view.z - view.x) * unit(_stressRandom);
+    float worldY = view.y + (view.w - view.y) * unit(_stressRandom);
+    int x = static_cast<int>(std::floor(worldX + 0.5f));
+    int y = static_cast<int>(std::floor(worldY + 0.5f));
+    Tile tile = _worldMap.getTile(x, y);
+    _worldMap.setTile(x, y, tile.type == 0 ? 1 : 0);
+  }
 }
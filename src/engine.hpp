@@ -3,14 +3,18 @@
 #include <SDL2/SDL_surface.h>
 #include <SDL2/SDL_video.h>
 #include <SDL2/SDL_vulkan.h>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
 #include <glm/ext/matrix_float4x4.hpp>
 #include <glm/ext/matrix_transform.hpp>
 #include <iostream>
+#include <random>
 #include <sstream>
 #include <stdexcept>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
@@ -18,16 +22,66 @@
 #include "../imgui/backends/imgui_impl_sdl2.h"
 #include "../imgui/backends/imgui_impl_vulkan.h"
 #include "../imgui/imgui.h"
+#include "./animation.hpp"
 #include "./camera.hpp"
+#include "./drawList.hpp"
+#include "./gpuCulling.hpp"
 #include "./initMeshes.hpp"
 #include "./initializers.hpp"
+#include "./mapFile.hpp"
+#include "./pipelineRegistry.hpp"
+#include "./shaderReflection.hpp"
+#include "./spriteBatch.hpp"
+#include "./textureFile.hpp"
+#include "./threadPool.hpp"
+#include "./tilemap.hpp"
+#include "./transformSystem.hpp"
 #include "./vertexData.hpp"
 #include "enteties.hpp"
 
 struct UniformBufferObject {
   // alignas(16) glm::mat4 model;
-  alignas(16) glm::mat4 view;
-  alignas(16) glm::mat4 proj;
+  alignas(16) glm::mat4 viewProj; // premultiplied once per frame
+  float time; // seconds since startup, drives sprite animation
+};
+
+// Staging buffer reserved on the render thread and filled by a worker, either
+// with a cooked payload or with pixels decoded straight into the mapping.
+struct DecodedTexture {
+  uint32_t textureId = 0;
+  bool loaded = false;
+  VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipLevels = 1;
+  std::vector<VkBufferImageCopy> regions; // empty for a single RGBA8 level
+  VkBuffer stagingBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+};
+
+// Copy submitted without waiting; retired once its fence signals.
+struct TextureUpload {
+  uint32_t textureId = 0;
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  VkFence fence = VK_NULL_HANDLE;
+  VkBuffer stagingBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+};
+
+// Counted while recording, shown in the ImGui window one frame late.
+struct DrawStats {
+  uint32_t meshDraws = 0; // mesh draws, indirect or not, and tile chunks
+  uint32_t tileChunks = 0; // drawn, part of meshDraws
+  uint32_t tilemapDraws = 0; // 1 when the GPU tilemap is drawn
+  uint32_t tileEditRegions = 0; // dirty chunk regions uploaded
+  uint64_t tileEditBytes = 0;
+  uint32_t meshObjectUploads = 0; // changed mesh objects copied
+  uint32_t spriteDraws = 0;
+  uint32_t sprites = 0;
+  // state binds of the CPU mesh loop, tile chunks and sprite batch, and what
+  // the same draws would bind in submission order
+  uint32_t binds = 0;
+  uint32_t unsortedBinds = 0;
 };
 
 class VulkanEngine {
@@ -78,15 +132,55 @@ private:
   std::vector<VkImageView> _swapchainImageViews;
   VkExtent2D _swapchainExtent;
 
+  // optional depth buffer, sized with the swapchain; VK2D_NO_DEPTH turns it
+  // off and meshes fall back to painter's order
+  bool _depthEnabled = false;
+  VkFormat _depthFormat = VK_FORMAT_UNDEFINED;
+  VkImage _depthImage = VK_NULL_HANDLE;
+  VkDeviceMemory _depthImageMemory = VK_NULL_HANDLE;
+  VkImageView _depthImageView = VK_NULL_HANDLE;
+  VkFormat findDepthFormat() const;
+  void createDepthResources();
+  void destroyDepthResources();
+
+  // set and pipeline layouts reflected from the shaders, owned by
+  // _layoutCache
+  LayoutCache _layoutCache;
   VkPipelineLayout _pipelineLayout;
+  VkPipelineLayout _spritePipelineLayout = VK_NULL_HANDLE;
   void createGraphicsPipeline();
-  VkShaderModule createShaderModule(const std::vector<char> &code);
-  static std::vector<char> readFile(const std::string &filename);
+  VkShaderModule createShaderModule(const ShaderCode &code);
 
   VkRenderingAttachmentInfoKHR createRenderingAttachmentInfo();
   VkRenderingInfoKHR
   createRenderingInfo(VkRenderingAttachmentInfoKHR &colorAttachmentInfo);
+  // created synchronously, the fallback for mesh pipelines still compiling
   VkPipeline _graphicsPipeline;
+  // compiled on the thread pool when first drawn, see PipelineRegistry
+  PipelineKey _spritePipeline = 0;
+  PipelineRegistry _pipelineRegistry;
+  PipelineDesc
+  pipelineDesc(const ShaderCode &vert, const ShaderCode &frag,
+               const VkPipelineVertexInputStateCreateInfo &vertexInputInfo,
+               bool alphaBlend);
+
+  // shader.vert specialized per atlas size and animated or not, see
+  // meshConstants; declared the first time a tile chunk needs one. Variant 0
+  // is unspecialized and reads everything from the push constants.
+  struct MeshVariant {
+    PipelineKey opaque = 0;
+    PipelineKey transparent = 0;
+  };
+  static constexpr uint32_t maxMeshVariants =
+      1u << (drawKey::pipelineBits - 1);
+  std::vector<MeshVariant> _meshVariants;
+  std::unordered_map<uint64_t, uint32_t> _meshVariantIndex;
+  PipelineDesc meshPipelineDesc(bool alphaBlend,
+                                std::vector<PipelineDesc::Constant> constants);
+  uint32_t meshVariant(const Mesh &mesh);
+  // orders _meshObjects (see _meshBlendedFirst) or the CPU draw loop
+  uint64_t meshDrawKey(const Mesh &mesh, uint32_t geometry);
+  VkPipeline meshPipeline(uint32_t variant, bool transparent);
 
   VkCommandPool _commandPool;
   void createCommandPool();
@@ -131,7 +225,8 @@ private:
                     VkMemoryPropertyFlags properties, VkBuffer &buffer,
                     VkDeviceMemory &bufferMemory);
 
-  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size,
+                  VkDeviceSize dstOffset = 0);
 
   VkDescriptorSetLayout _descriptorSetLayout;
   VkDescriptorPool _descriptorPool;
@@ -143,18 +238,160 @@ private:
 
   void updateUniformBuffer(uint32_t currentImage);
 
+  // visible world size, from the same worldWidth/zoom rule as the projection
+  glm::vec2 cameraExtent() const;
+  // world space min.xy, max.xy of the view
+  glm::vec4 cameraRect() const;
+
+  std::chrono::high_resolution_clock::time_point _startTime =
+      std::chrono::high_resolution_clock::now();
+  // same clock as UniformBufferObject::time, used for clip start times
+  float engineTime() const;
+
   std::vector<Mesh> _meshes;
+  TransformSystem _transforms{_meshes};
   void createMesh(const std::vector<vertexData::Vertex> &vertices,
-                  const std::vector<uint16_t> &indices,
+                  const std::vector<uint32_t> &indices,
                   const glm::mat4 &inittialTransform = glm::mat4(1.0f),
                   glm::vec3 position = glm::vec3(0.0f),
                   const char *texturePath = "../textures/forest-2.png",
                   bool playerMesh = false);
-
-  void uploadToBuffer(const void *data, VkDeviceSize size, VkBuffer dstBuffer);
+  // bounds and a range of the mesh geometry buffers, the transform must
+  // already be set
+  void uploadMesh(Mesh &mesh, const std::vector<vertexData::Vertex> &vertices,
+                  const std::vector<uint32_t> &indices);
+
+  // Every mesh's vertices and 32-bit indices are appended to one pair of
+  // device local buffers, so all of them draw from a single binding. Growing
+  // them waits for the device, meshes are not expected to be added per frame.
+  VkBuffer _meshVertexBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory _meshVertexMemory = VK_NULL_HANDLE;
+  VkBuffer _meshIndexBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory _meshIndexMemory = VK_NULL_HANDLE;
+  uint32_t _meshVertexCount = 0;
+  uint32_t _meshVertexCapacity = 0;
+  uint32_t _meshIndexCount = 0;
+  uint32_t _meshIndexCapacity = 0;
+  void reserveMeshGeometry(uint32_t vertexCount, uint32_t indexCount);
+  void destroyMeshGeometry();
+
+  // picks UINT16 when every vertex is addressable with 16 bits
+  VkIndexType uploadIndexBuffer(const std::vector<uint32_t> &indices,
+                                size_t vertexCount, VkBuffer &buffer,
+                                VkDeviceMemory &bufferMemory);
+  void uploadToBuffer(const void *data, VkDeviceSize size, VkBuffer dstBuffer,
+                      VkDeviceSize dstOffset = 0);
 
   void createAllMeshes();
 
+  std::vector<SpriteSheet> _spriteSheets;
+
+  // instanced sprites: one shared unit quad, one instance buffer per frame
+  SpriteBatch _spriteBatch;
+  DrawList _drawList;
+  VkBuffer _spriteQuadVertexBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory _spriteQuadVertexBufferMemory = VK_NULL_HANDLE;
+  VkBuffer _spriteQuadIndexBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory _spriteQuadIndexBufferMemory = VK_NULL_HANDLE;
+  VkIndexType _spriteQuadIndexType = VK_INDEX_TYPE_UINT16;
+  std::vector<VkBuffer> _spriteInstanceBuffers;
+  std::vector<VkDeviceMemory> _spriteInstanceBufferMemory;
+  std::vector<void *> _spriteInstanceBuffersMapped;
+  std::vector<uint32_t> _spriteInstanceCapacity;
+  void createSpriteBatchBuffers();
+  void reserveSpriteInstances(uint32_t frame, uint32_t count);
+  void destroySpriteInstanceBuffer(uint32_t frame);
+  void drawSprites(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+  VkDescriptorSet textureDescriptorSet(uint32_t textureId) const;
+
+  // moving sprites for load testing, count set from the ImGui window
+  int _stressSpriteCount = 0;
+  std::vector<SpriteInstance> _stressSprites;
+  TransformSoA _stressState; // position, velocity, rotation, scale per sprite
+  std::vector<uint32_t> _stressTextureIds;
+  std::mt19937 _stressRandom{1234};
+  void updateStressSprites(float deltaTime);
+
+  DrawStats _drawStats;
+
+  // fragment shader invocations per frame over the scene draws (not ImGui),
+  // overdraw is that divided by the pixel count
+  bool _overdrawQuerySupported = false;
+  VkQueryPool _overdrawQueryPool = VK_NULL_HANDLE;
+  std::vector<bool> _overdrawQueryIssued;
+  uint64_t _fragmentInvocations = 0;
+  void createOverdrawQueries();
+  void readOverdrawQuery(uint32_t currentFrame);
+
+  // GPU-driven drawing: cull.comp tests each object against the camera rect
+  // and writes the indirect commands. _meshes go through it whenever the
+  // device supports it, the stress sprites when _gpuCulling is set.
+  bool _gpuCullingSupported = false;
+  bool _gpuCulling = false;
+  bool _validateGpuCulling = false;
+  uint32_t _gpuVisibleCount = 0;
+  uint32_t _meshVisibleCount = 0;
+  VkDescriptorSetLayout _cullSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSetLayout _bindlessSetLayout = VK_NULL_HANDLE;
+  VkPipelineLayout _cullPipelineLayout = VK_NULL_HANDLE;
+  VkPipelineLayout _bindlessPipelineLayout = VK_NULL_HANDLE;
+  VkPipeline _cullPipeline = VK_NULL_HANDLE;
+  PipelineKey _gpuSpritePipeline = 0;
+  // gpu_mesh.vert, built up front since every mesh draws with them
+  VkPipeline _gpuMeshPipeline = VK_NULL_HANDLE;
+  VkPipeline _gpuMeshBlendPipeline = VK_NULL_HANDLE;
+  std::vector<GpuCullFrame> _gpuCullFrames;
+  void createGpuCulling();
+  void destroyGpuCulling();
+  void createCullBatch(GpuCullBatch &batch, uint32_t frame);
+  void destroyCullBatch(GpuCullBatch &batch);
+  void reserveCullDraws(GpuCullBatch &batch, uint32_t count);
+  void writeCullObjects(GpuCullBatch &batch, VkBuffer objectBuffer);
+  void reserveGpuObjects(GpuCullFrame &frame, uint32_t count);
+  void destroyGpuObjectBuffer(GpuCullFrame &frame);
+  void writeBindlessTexture(uint32_t slot, const Texture &texture);
+  uint32_t bindlessSlot(uint32_t textureId) const;
+  void cullObjects(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+  void dispatchCull(VkCommandBuffer commandBuffer, GpuCullBatch &batch,
+                    uint32_t objectCount, glm::vec4 viewRect);
+  void drawGpuObjects(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+  // the opaque draws, or the blended ones, in object order
+  void drawGpuMeshes(VkCommandBuffer commandBuffer, uint32_t currentFrame,
+                     bool ordered);
+  // without GPU culling: _meshes culled and sorted into _drawList, then
+  // drawn one pass at a time
+  void sortMeshDraws(glm::vec4 viewRect);
+  void drawMeshes(VkCommandBuffer commandBuffer, uint32_t pass);
+  void readGpuCullResult(uint32_t currentFrame);
+  uint32_t readCullCounts(GpuCullBatch &batch, const char *name);
+
+  // One GpuObject per mesh in draw order: opaque meshes front to back, then
+  // from _meshBlendedFirst the blended ones back to front (every mesh without
+  // a depth buffer). They stay in _meshObjectBuffer between frames; only the
+  // meshes marked changed are copied again, the whole list when meshes are
+  // added.
+  std::vector<GpuObject> _meshObjects;
+  std::vector<uint32_t> _meshObjectOf; // object index per mesh
+  uint32_t _meshBlendedFirst = 0;
+  std::vector<uint8_t> _meshChangedFlags; // per mesh
+  std::vector<uint32_t> _meshesChanged;
+  bool _meshObjectsRebuilt = false;
+  VkBuffer _meshObjectBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory _meshObjectMemory = VK_NULL_HANDLE;
+  uint32_t _meshObjectCapacity = 0;
+  // transform, animation or texture residency changed; layer and
+  // transparency are read when the list is rebuilt
+  void meshChanged(uint32_t mesh);
+  GpuObject meshObject(const Mesh &mesh) const;
+  void rebuildMeshObjects();
+  void reserveMeshObjects(uint32_t count);
+  void destroyMeshObjectBuffer();
+  void reserveMeshStaging(GpuCullFrame &frame, uint32_t count);
+  void destroyMeshStaging(GpuCullFrame &frame);
+  void flushMeshObjects(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+  void createAnimatedSprite(const SpriteSheet &sheet, const char *clipName,
+                            glm::vec3 position);
+
   void processInput(SDL_Event event);
 
   Camera2D _camera2d;
@@ -167,12 +404,44 @@ private:
   bool _playerMode{false};
   void updateMeshes(float deltaTime);
 
-  void createTextureImage(const char *filePath, VkImage &textureImage,
-                          VkDeviceMemory &textureImageMemory);
+  std::vector<Texture> _textures;
+  std::unordered_map<std::string, uint32_t> _textureIds;
+
+  // decode jobs push into _decodedTextures, declared before the pool so the
+  // workers are joined first
+  CompletionQueue<DecodedTexture> _decodedTextures;
+  ThreadPool _threadPool;
+  uint32_t _pendingTextureLoads = 0;
+
+  // textures are streamed: requests queue up, the nearest to the camera are
+  // decoded first and meshes draw with _placeholderTexture meanwhile
+  Texture _placeholderTexture;
+  std::vector<uint32_t> _queuedTextures;
+  std::vector<TextureUpload> _textureUploads;
+  uint32_t _maxTextureLoadsInFlight = 4;
+  std::vector<float> _textureDistance; // per texture, reused each dispatch
+  bool _texturesStreaming = false;
+  uint32_t _failedTextures = 0;
+  std::chrono::high_resolution_clock::time_point _streamingStart;
+
+  uint32_t requestTexture(const char *filePath);
+  void startTextureLoad(uint32_t textureId);
+  bool openCookedTexture(const std::string &filePath,
+                         texfile::MappedFile &file,
+                         texfile::TextureView &view);
+  void updateTextureStreaming();
+  void textureLoadFailed(uint32_t textureId);
+  void stopTextureStreaming();
+  void retireTextureUpload(TextureUpload &upload);
+  void createPlaceholderTexture();
+  void createTextureImage(DecodedTexture &decoded, Texture &texture);
   void createImage(uint32_t width, uint32_t height, VkFormat format,
                    VkImageTiling tiling, VkImageUsageFlags usage,
                    VkMemoryPropertyFlags properties, VkImage &image,
-                   VkDeviceMemory &imageMemory);
+                   VkDeviceMemory &imageMemory, uint32_t mipLevels = 1);
+
+  bool _textureCompressionBC{false};
+  bool _useCookedTextures{true};
 
   // VkImage _textureImage;
   // VkImageView _textureImageView;
@@ -181,17 +450,133 @@ private:
 
   void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width,
                          uint32_t height);
+  void copyBufferToImage(VkBuffer buffer, VkImage image,
+                         const std::vector<VkBufferImageCopy> &regions);
 
   void createTextureImageView(VkImage &textureImage,
-                              VkImageView &textureImageView);
+                              VkImageView &textureImageView, VkFormat format,
+                              uint32_t mipLevels);
 
-  VkImageView createImageView(VkImage image, VkFormat format);
+  VkImageView
+  createImageView(VkImage image, VkFormat format, uint32_t mipLevels = 1,
+                  VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
 
   void createImageViews();
-  void createTextureSampler(VkSampler &textureSampler);
-
-  void createMeshDescriptorSet(Mesh &mesh);
-
-  void createTilemapMesh(const Tilemap &tilemap, const char *texturePath);
+  void createTextureSampler(VkSampler &textureSampler, uint32_t mipLevels);
+
+  void createTextureDescriptorSet(Texture &texture);
+
+  // The world map is drawn in tileChunkSize x tileChunkSize chunks. A
+  // chunk's mesh is queued for building when it comes within a chunk of the
+  // camera and uploaded before rendering starts; only the chunks under the
+  // camera are visited each frame.
+  static constexpr int tileChunkSize = Tilemap::chunkSize;
+  static constexpr uint32_t maxTileChunkBuildsPerFrame = 8;
+  static constexpr uint32_t noTileChunkSlot = ~0u;
+  struct TileChunk {
+    // buffers belong to the chunk pool, never cleaned up through the mesh
+    Mesh mesh;
+    bool built = false;
+    bool queued = false;
+    uint32_t slot = noTileChunkSlot; // none for a chunk without tiles
+    uint64_t lastVisible = 0;
+  };
+  Tilemap _worldMap;
+  std::vector<TileChunk> _tileChunks; // row-major, Tilemap::chunksX() wide
+  std::vector<uint32_t> _tileChunkBuilds;
+  uint32_t _tileChunksBuilt = 0;
+  uint64_t _tileFrame = 0;
+  uint32_t _tileTextureId = 0;
+  void createTilemap(Tilemap tilemap, const char *texturePath);
+  // marks what is in view and queues the chunks that need a mesh
+  void updateTileChunks();
+  // one draw per chunk under the camera, they share pipeline and texture
+  void drawTileChunks(VkCommandBuffer commandBuffer, glm::vec4 viewRect);
+  // the chunks a world rectangle touches, clipped to the map
+  void tileChunkRange(glm::vec4 rect, int &firstX, int &lastX, int &firstY,
+                      int &lastY) const;
+
+  // A map loaded from a .vmap file stays mapped, and each chunk is decoded
+  // into _worldMap the first time the camera comes within a chunk of it.
+  // Decoding overwrites edits made to a chunk before it was loaded.
+  std::string _mapPath = "../maps/world.vmap";
+  texfile::MappedFile _mapFile;
+  mapfile::MapView _mapView;
+  std::vector<uint8_t> _tileChunkLoaded; // empty once everything is loaded
+  uint32_t _tileChunksLoaded = 0;
+  bool loadMap(const std::string &path);
+  void streamTileChunks();
+  void decodeMapChunk(uint32_t index);
+  void finishMapStreaming();
+  bool saveMap(const std::string &path);
+
+  // By default the map is an R16_UINT image of tile types, one texel per
+  // tile, and drawn as one screen-covering quad (tilemap.vert/.frag) at the
+  // end of the opaque pass. VK2D_TILEMAP_MESH, or a map larger than the
+  // device's 2D image limit, keeps the chunk meshes above.
+  bool _gpuTilemap = false;
+  VkImage _tileIndexImage = VK_NULL_HANDLE;
+  VkDeviceMemory _tileIndexMemory = VK_NULL_HANDLE;
+  VkImageView _tileIndexView = VK_NULL_HANDLE;
+  VkSampler _tileIndexSampler = VK_NULL_HANDLE;
+  VkPipelineLayout _tilemapPipelineLayout = VK_NULL_HANDLE;
+  PipelineKey _tilemapPipeline = 0;
+  // per frame for the uniform buffer; the atlas binding is rewritten when
+  // the tile texture becomes resident
+  std::vector<VkDescriptorSet> _tilemapSets;
+  std::vector<VkImageView> _tilemapSetAtlas;
+  void createGpuTilemap();
+  void destroyGpuTilemap();
+  void drawGpuTilemap(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+
+  // Chunk meshes live in fixed slots of one pooled buffer, each with room
+  // for a full chunk so edits always patch in place. All slots share one
+  // quad index list at the start of the buffer. When the pool is full the
+  // least recently visible chunk gives up its slot.
+  //
+  // Fully zoomed out the view is 25 tiles wide, so with the one chunk
+  // margin at most 4 chunk columns are in view. 256 slots leave 64 rows,
+  // which a window narrower than about 1:75 would still exceed; builds then
+  // wait for a slot and _tileChunksStarved reports it once.
+  //
+  // pool: uint16_t indices[6 * tileChunkQuads] | Vertex[4 * quads] per slot
+  static constexpr uint32_t tileChunkQuads = tileChunkSize * tileChunkSize;
+  static constexpr uint32_t maxTileChunkSlots = 256;
+  static constexpr VkDeviceSize tileChunkVertexBytes =
+      sizeof(vertexData::Vertex) * 4 * tileChunkQuads;
+  // padded to a whole vertex, so slots can be addressed by vertexOffset
+  static constexpr VkDeviceSize tileChunkIndexBytes =
+      (sizeof(uint16_t) * 6 * tileChunkQuads + sizeof(vertexData::Vertex) -
+       1) /
+      sizeof(vertexData::Vertex) * sizeof(vertexData::Vertex);
+  VkBuffer _tileChunkPool = VK_NULL_HANDLE;
+  VkDeviceMemory _tileChunkPoolMemory = VK_NULL_HANDLE;
+  std::vector<uint32_t> _tileChunkFreeSlots;
+  std::vector<uint32_t> _tileChunkSlotOwner; // chunk index per slot
+  bool _tileChunksStarved = false;
+  void createTileChunkPool();
+  void destroyTileChunkPool();
+  uint32_t acquireTileChunkSlot();
+  VkDeviceSize tileChunkSlotOffset(uint32_t slot) const;
+
+  // Tile edits: the regions Tilemap marked dirty are copied through a per
+  // frame staging buffer before rendering starts, as tile index texels or
+  // as the changed vertices of built chunks. Queued chunk builds go through
+  // the same buffer.
+  static constexpr VkDeviceSize maxTileEditBytesPerFrame = 4 << 20;
+  std::vector<VkBuffer> _tileEditStaging;
+  std::vector<VkDeviceMemory> _tileEditStagingMemory;
+  std::vector<void *> _tileEditStagingMapped;
+  std::vector<VkDeviceSize> _tileEditStagingCapacity;
+  std::vector<Tilemap::DirtyRegion> _tileEditRegions;
+  void reserveTileEditStaging(uint32_t frame, VkDeviceSize size);
+  void destroyTileEditStaging(uint32_t frame);
+  void flushTileEdits(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+  void flushTileTexels(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+  void flushTileVertices(VkCommandBuffer commandBuffer, uint32_t currentFrame);
+
+  // random edits under the camera for load testing, set from ImGui
+  int _stressTileEdits = 0;
+  void updateStressTileEdits();
   void createMap();
 };
@@ -5,7 +5,7 @@
 
 void Player::playerMovement(SDL_Event event) {
 
-  if (!playerMesh)
+  if (!transforms)
     return;
 
   if (event.type == SDL_KEYDOWN) {
@@ -27,11 +27,11 @@ void Player::playerMovement(SDL_Event event) {
     switch (event.key.keysym.sym) {
     case SDLK_w:
     case SDLK_s:
-      playerMesh->velocity.y = 0;
+      setVelocityY(0);
       break;
     case SDLK_a:
     case SDLK_d:
-      playerMesh->velocity.x = 0;
+      setVelocityX(0);
       break;
     }
   }
@@ -39,21 +39,33 @@ void Player::playerMovement(SDL_Event event) {
 
 void Player::movePlayer(playerDirections direction) {
   if (direction == UP) {
-    playerMesh->velocity.y = playerSpeed;
+    setVelocityY(playerSpeed);
   }
   if (direction == DOWN) {
-    playerMesh->velocity.y = -playerSpeed;
+    setVelocityY(-playerSpeed);
   }
   if (direction == LEFT) {
-    playerMesh->velocity.x = -playerSpeed;
+    setVelocityX(-playerSpeed);
   }
   if (direction == RIGHT) {
-    playerMesh->velocity.x = playerSpeed;
+    setVelocityX(playerSpeed);
   }
 }
 
 void Player::stopMovement() {
-  if (playerMesh) {
-    playerMesh->velocity = glm::vec3(0.0f);
+  if (transforms) {
+    transforms->setVelocity(playerMesh, glm::vec2(0.0f));
   }
 }
+
+void Player::setVelocityX(float x) {
+  glm::vec2 velocity = transforms->velocity(playerMesh);
+  velocity.x = x;
+  transforms->setVelocity(playerMesh, velocity);
+}
+
+void Player::setVelocityY(float y) {
+  glm::vec2 velocity = transforms->velocity(playerMesh);
+  velocity.y = y;
+  transforms->setVelocity(playerMesh, velocity);
+}
@@ -1,18 +1,27 @@
 #pragma once
 
 #include "initMeshes.hpp"
+#include "transformSystem.hpp"
 #include <SDL2/SDL.h>
 #include <vulkan/vulkan.h>
 
 class Player {
 public:
-  Mesh *playerMesh = nullptr;
+  TransformSystem *transforms = nullptr;
+  uint32_t playerMesh = 0;
   enum playerDirections { UP, DOWN, LEFT, RIGHT };
   float playerSpeed = 5.0f;
 
   const Uint8 *keyboardStateArray = SDL_GetKeyboardState(nullptr);
   void playerMovement(SDL_Event e);
-  void addMesh(Mesh &playerMesh) { this->playerMesh = &playerMesh; }
+  void addMesh(TransformSystem &transforms, uint32_t playerMesh) {
+    this->transforms = &transforms;
+    this->playerMesh = playerMesh;
+  }
   void movePlayer(playerDirections direction);
   void stopMovement();
+
+private:
+  void setVelocityX(float x);
+  void setVelocityY(float y);
 };
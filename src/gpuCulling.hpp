@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+// Records shared with shaders/cull.comp, gpu_sprite.vert and gpu_mesh.vert
+// (std430).
+struct GpuObject {
+  glm::vec4 bounds; // local AABB: min.xy, max.xy
+  glm::vec4 uvRect;
+  glm::mat3x2 transform; // 2D affine: x axis, y axis, translation
+  uint32_t tint;
+  uint32_t textureIndex; // bindless slot, 0 is the placeholder
+  uint32_t firstIndex;   // mesh range in the shared index buffer
+  uint32_t indexCount;
+  int32_t vertexOffset;
+  // sprite sheet animation and layer depth, read by gpu_mesh.vert only
+  uint32_t atlasColumns;
+  uint32_t atlasRows;
+  uint32_t baseFrame;
+  uint32_t frameCount;
+  float fps;
+  float startTime;
+  uint32_t loop;
+  float depth;
+  uint32_t padding;
+};
+static_assert(sizeof(GpuObject) == 112, "must match GpuObject in cull.comp");
+
+struct CullPushConstants {
+  glm::vec4 viewRect; // world space min.xy, max.xy
+  uint32_t objectCount;
+  // objects from here on keep their own command slot, see GpuCullBatch
+  uint32_t orderedFirst;
+  uint32_t padding[2];
+};
+
+// matches DrawCounts in cull.comp
+struct GpuCullCounts {
+  uint32_t compacted; // commands written before orderedFirst
+  uint32_t ordered;   // visible objects from orderedFirst on
+};
+
+// bindless texture array size in gpu_sprite.frag
+constexpr uint32_t maxBindlessTextures = 128;
+
+// One cull.comp dispatch and the draws it feeds. Objects before orderedFirst
+// are compacted to the front of the command buffer, drawn with an indirect
+// count; the ones after it keep command slot = object index with zero
+// instances when culled, so a plain indirect draw keeps their order: the
+// sprites are all compacted, the meshes all keep their slot. The counts stay
+// host visible so they can be checked.
+struct GpuCullBatch {
+  VkBuffer drawBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory drawBufferMemory = VK_NULL_HANDLE;
+  uint32_t capacity = 0;
+  VkBuffer countBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory countBufferMemory = VK_NULL_HANDLE;
+  GpuCullCounts *countMapped = nullptr;
+
+  VkDescriptorSet cullSet = VK_NULL_HANDLE;
+  VkDescriptorSet drawSet = VK_NULL_HANDLE;
+
+  uint32_t submittedObjects = 0;
+  uint32_t orderedFirst = 0;
+  uint32_t expectedVisible = 0;
+};
+
+// Per frame in flight. Stress sprite objects are rewritten by the CPU every
+// frame; mesh objects live in one device local buffer shared by the frames
+// and only the changed ones go through meshStaging.
+struct GpuCullFrame {
+  VkBuffer objectBuffer = VK_NULL_HANDLE;
+  VkDeviceMemory objectBufferMemory = VK_NULL_HANDLE;
+  void *objectsMapped = nullptr;
+  uint32_t objectCapacity = 0;
+  GpuCullBatch sprites;
+
+  VkBuffer meshStaging = VK_NULL_HANDLE;
+  VkDeviceMemory meshStagingMemory = VK_NULL_HANDLE;
+  void *meshStagingMapped = nullptr;
+  uint32_t meshStagingCapacity = 0; // in objects
+  GpuCullBatch meshes;
+};
+
+// CPU mirror of the test in cull.comp, used to validate the GPU count and
+// to cull meshes when the device has no GPU culling
+inline bool gpuObjectVisible(const GpuObject &object, glm::vec4 viewRect) {
+  const glm::mat3x2 &m = object.transform;
+  float centerX = (object.bounds.x + object.bounds.z) * 0.5f;
+  float centerY = (object.bounds.y + object.bounds.w) * 0.5f;
+  float extentX = (object.bounds.z - object.bounds.x) * 0.5f;
+  float extentY = (object.bounds.w - object.bounds.y) * 0.5f;
+
+  float worldX = m[0].x * centerX + m[1].x * centerY + m[2].x;
+  float worldY = m[0].y * centerX + m[1].y * centerY + m[2].y;
+  float worldExtentX = std::abs(m[0].x) * extentX + std::abs(m[1].x) * extentY;
+  float worldExtentY = std::abs(m[0].y) * extentX + std::abs(m[1].y) * extentY;
+
+  return worldX + worldExtentX >= viewRect.x &&
+         worldY + worldExtentY >= viewRect.y &&
+         worldX - worldExtentX <= viewRect.z &&
+         worldY - worldExtentY <= viewRect.w;
+}
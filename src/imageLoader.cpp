@@ -0,0 +1,45 @@
+#include "./imageLoader.hpp"
+#include <cstring>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+bool imageLoader::info(const char *path, uint32_t &width, uint32_t &height) {
+  int w, h, channels;
+  if (!stbi_info(path, &w, &h, &channels) || w <= 0 || h <= 0) {
+    return false;
+  }
+  width = static_cast<uint32_t>(w);
+  height = static_cast<uint32_t>(h);
+  return true;
+}
+
+size_t imageLoader::decodeSize(uint32_t width, uint32_t height) {
+  return static_cast<size_t>(width) * height * 4;
+}
+
+bool imageLoader::decodeInto(const char *path, void *dst, size_t dstSize,
+                             uint32_t width, uint32_t height) {
+  size_t imageSize = decodeSize(width, height);
+  if (dstSize < imageSize) {
+    return false;
+  }
+
+  // stb reads its own output back while defiltering, so it decodes into
+  // cached heap memory and only the finished image goes to dst
+  int w, h, channels;
+  stbi_uc *pixels = stbi_load(path, &w, &h, &channels, STBI_rgb_alpha);
+  if (pixels == nullptr) {
+    return false;
+  }
+
+  bool matches =
+      static_cast<uint32_t>(w) == width && static_cast<uint32_t>(h) == height;
+  if (matches) {
+    std::memcpy(dst, pixels, imageSize);
+  }
+  stbi_image_free(pixels);
+  return matches;
+}
+
+const char *imageLoader::failureReason() { return stbi_failure_reason(); }
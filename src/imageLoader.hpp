@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Thin wrapper around stb_image that decodes on the heap and writes the
+// finished RGBA8 image into caller-owned memory (a mapped staging buffer)
+// with a single sequential copy.
+namespace imageLoader {
+
+// reads only the header; false if the file is missing or not an image
+bool info(const char *path, uint32_t &width, uint32_t &height);
+
+// bytes to reserve for an RGBA8 decode
+size_t decodeSize(uint32_t width, uint32_t height);
+
+// decodes RGBA8 into dst, which must hold decodeSize(width, height) bytes.
+// Returns false on decode failure or if the image no longer matches the
+// dimensions reported by info().
+bool decodeInto(const char *path, void *dst, size_t dstSize, uint32_t width,
+                uint32_t height);
+
+const char *failureReason();
+
+}; // namespace imageLoader
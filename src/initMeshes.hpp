@@ -1,111 +1,105 @@
 #pragma once
 
+#include "./animation.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <limits>
+#include <string>
 #include <vector>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
-struct Mesh {
-  VkBuffer vertexBuffer = VK_NULL_HANDLE;
-  VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
-  VkBuffer indexBuffer = VK_NULL_HANDLE;
-  VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
-  uint16_t indexCount;
-
-  VkDescriptorSet descriptorSet;
-
-  VkImage textureImage;
-  VkImageView textureImageView;
-  VkSampler textureSampler;
-  VkDeviceMemory textureImageMemory;
-
-  glm::mat4 transform;
-  glm::vec3 position = glm::vec3(0.0f);
-  glm::vec3 velocity = glm::vec3(0.0f);
-  float rotation = 0.0f;
-  glm::vec3 scale = glm::vec3(1.0f);
-
-  bool plyerMesh = false;
+// Textures are shared between meshes, each unique path is loaded once.
+struct Texture {
+  std::string path;
 
-  void update(float deltaTime) {
-    position += velocity * deltaTime;
-    updateTransform();
-  }
+  VkImage image = VK_NULL_HANDLE;
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkImageView view = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+  VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
-  void updateTransform() {
-    transform = glm::translate(glm::mat4(1.0f), position) *
-                glm::rotate(glm::mat4(1.0f), rotation, glm::vec3(0, 0, 1)) *
-                glm::scale(glm::mat4(1.0f), scale);
-  }
+  // set once the upload fence signals, until then draws use the placeholder
+  bool resident = false;
+  // the file could not be read or decoded, draws keep the placeholder
+  bool failed = false;
 
   void cleanup(VkDevice device) {
-    if (textureImageView != VK_NULL_HANDLE) {
-      vkDestroyImageView(device, textureImageView, nullptr);
-      textureImageView = VK_NULL_HANDLE;
-    }
-    if (textureImage != VK_NULL_HANDLE) {
-      vkDestroyImage(device, textureImage, nullptr);
-      textureImage = VK_NULL_HANDLE;
-    }
-    if (textureImageMemory != VK_NULL_HANDLE) {
-      vkFreeMemory(device, textureImageMemory, nullptr);
-      textureImageMemory = VK_NULL_HANDLE;
-    }
-    if (textureSampler != VK_NULL_HANDLE) {
-      vkDestroySampler(device, textureSampler, nullptr);
-      textureSampler = VK_NULL_HANDLE;
-    }
-    if (vertexBuffer != VK_NULL_HANDLE) {
-      vkDestroyBuffer(device, vertexBuffer, nullptr);
-      vertexBuffer = VK_NULL_HANDLE;
+    if (view != VK_NULL_HANDLE) {
+      vkDestroyImageView(device, view, nullptr);
+      view = VK_NULL_HANDLE;
     }
-    if (vertexBufferMemory != VK_NULL_HANDLE) {
-      vkFreeMemory(device, vertexBufferMemory, nullptr);
-      vertexBufferMemory = VK_NULL_HANDLE;
+    if (image != VK_NULL_HANDLE) {
+      vkDestroyImage(device, image, nullptr);
+      image = VK_NULL_HANDLE;
     }
-    if (indexBuffer != VK_NULL_HANDLE) {
-      vkDestroyBuffer(device, indexBuffer, nullptr);
-      indexBuffer = VK_NULL_HANDLE;
+    if (memory != VK_NULL_HANDLE) {
+      vkFreeMemory(device, memory, nullptr);
+      memory = VK_NULL_HANDLE;
     }
-    if (indexBufferMemory != VK_NULL_HANDLE) {
-      vkFreeMemory(device, indexBufferMemory, nullptr);
-      indexBufferMemory = VK_NULL_HANDLE;
+    if (sampler != VK_NULL_HANDLE) {
+      vkDestroySampler(device, sampler, nullptr);
+      sampler = VK_NULL_HANDLE;
     }
   }
 };
 
-struct Tile {
-  uint16_t type;
-};
+// Axis-aligned rects are stored as (min.x, min.y, max.x, max.y).
+inline bool rectsOverlap(glm::vec4 a, glm::vec4 b) {
+  return a.x <= b.z && a.z >= b.x && a.y <= b.w && a.w >= b.y;
+}
 
-struct Tilemap {
-public:
-  std::vector<std::vector<Tile>> tiles;
-  int width;
-  int height;
+// Higher layers sit closer to the camera. Layer 255 maps to 0, the depth the
+// sprite batches draw at, so batched sprites stay on top of every mesh.
+inline float layerDepth(uint8_t layer) {
+  return 1.0f - (static_cast<float>(layer) + 1.0f) / 256.0f;
+}
 
-  Tilemap(int w, int h) : width(w), height(h) {
-    tiles.resize(height, std::vector<Tile>(width));
+struct Mesh {
+  // Geometry is a range of buffers the mesh does not own: the shared mesh
+  // buffers for _meshes, which are drawn from there and leave these null,
+  // or the tile chunk pool.
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  // added to every index, for meshes that share one buffer
+  int32_t vertexOffset = 0;
 
-    for (auto &row : tiles) {
-      for (auto &tile : row) {
-        tile.type = 0;
-      }
-    }
-  }
+  uint32_t textureId = 0;
+  SpriteAnimation animation;
 
-  void setTile(int x, int y, uint16_t type) {
-    if (x >= 0 && x < width && y >= 0 && y < height) {
-      tiles[y][x].type = type;
-    }
-  }
+  // higher layers cover lower ones, the tilemap sits on 0
+  uint8_t layer = 1;
+  // blended and drawn back to front after the opaque meshes; opaque meshes
+  // draw front to back so the depth test rejects what they cover
+  bool transparent = false;
 
-  Tile getTile(int x, int y) const {
-    if (x >= 0 && x < width && y >= 0 && y < height) {
-      return tiles[y][x];
-    }
+  // 2D affine (x axis, y axis, translation) written by TransformSystem,
+  // which owns position, velocity, rotation and scale
+  glm::mat3x2 transform;
+
+  // local bounds come from the vertices, world bounds follow the transform
+  glm::vec4 localBounds = glm::vec4(0.0f);
+  glm::vec4 worldBounds = glm::vec4(0.0f);
 
-    return Tile{0};
+  bool plyerMesh = false;
+
+  void updateBounds() {
+    glm::vec2 corners[4] = {{localBounds.x, localBounds.y},
+                            {localBounds.z, localBounds.y},
+                            {localBounds.x, localBounds.w},
+                            {localBounds.z, localBounds.w}};
+
+    glm::vec2 lo(std::numeric_limits<float>::max());
+    glm::vec2 hi(std::numeric_limits<float>::lowest());
+    for (const auto &corner : corners) {
+      glm::vec2 p =
+          transform[0] * corner.x + transform[1] * corner.y + transform[2];
+      lo = glm::min(lo, p);
+      hi = glm::max(hi, p);
+    }
+    worldBounds = glm::vec4(lo, hi);
   }
 };
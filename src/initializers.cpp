@@ -4,11 +4,21 @@
 void vkinit::transitionImageLayout(VkImage image, VkImageLayout oldLayout,
                                    VkImageLayout newLayout,
                                    VkCommandPool commandPool, VkDevice device,
-                                   VkQueue graphicsQueue) {
+                                   VkQueue graphicsQueue, uint32_t mipLevels) {
 
   VkCommandBuffer commandBuffer =
       vkinit::beginSingleTimeCommands(commandPool, device);
 
+  vkinit::transitionImage(commandBuffer, image, oldLayout, newLayout,
+                          mipLevels);
+
+  vkinit::endSingleTimeCommands(commandBuffer, graphicsQueue, device,
+                                commandPool);
+}
+
+void vkinit::transitionImage(VkCommandBuffer commandBuffer, VkImage image,
+                             VkImageLayout oldLayout, VkImageLayout newLayout,
+                             uint32_t mipLevels) {
   VkPipelineStageFlags sourceStage;
   VkPipelineStageFlags destinationStage;
   VkAccessFlags srcAccessMask = 0;
@@ -28,12 +38,30 @@ void vkinit::transitionImageLayout(VkImage image, VkImageLayout oldLayout,
 
     sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
     destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  } else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+             newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+    // updating a sampled image in place, after earlier reads are done
+    srcAccessMask = 0;
+    dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
   } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
              newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) {
     sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
     destinationStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     srcAccessMask = 0;
     dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
+             newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) {
+    // the depth image is shared by every frame in flight, wait for the
+    // previous frame's depth writes before clearing it again
+    sourceStage = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                       VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
   } else if (oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL &&
              newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
     sourceStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
@@ -54,9 +82,12 @@ void vkinit::transitionImageLayout(VkImage image, VkImageLayout oldLayout,
   barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
   barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
   barrier.image = image;
-  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.aspectMask =
+      newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL
+          ? VK_IMAGE_ASPECT_DEPTH_BIT
+          : VK_IMAGE_ASPECT_COLOR_BIT;
   barrier.subresourceRange.baseMipLevel = 0;
-  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.levelCount = mipLevels;
   barrier.subresourceRange.baseArrayLayer = 0;
   barrier.subresourceRange.layerCount = 1;
   barrier.srcAccessMask = srcAccessMask;
@@ -64,9 +95,6 @@ void vkinit::transitionImageLayout(VkImage image, VkImageLayout oldLayout,
 
   vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0,
                        nullptr, 0, nullptr, 1, &barrier);
-
-  vkinit::endSingleTimeCommands(commandBuffer, graphicsQueue, device,
-                                commandPool);
 }
 
 VkCommandBuffer vkinit::beginSingleTimeCommands(VkCommandPool commandPool,
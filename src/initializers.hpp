@@ -5,8 +5,10 @@
 
 namespace vkinit {
 
+// records the barrier only, the caller owns submission
 void transitionImage(VkCommandBuffer commandBuffer, VkImage image,
-                     VkImageLayout oldLayout, VkImageLayout newLayout);
+                     VkImageLayout oldLayout, VkImageLayout newLayout,
+                     uint32_t mipLevels = 1);
 
 VkCommandBuffer beginSingleTimeCommands(VkCommandPool commandPool,
                                         VkDevice device);
@@ -17,6 +19,7 @@ void endSingleTimeCommands(VkCommandBuffer &commandBuffer,
 
 void transitionImageLayout(VkImage image, VkImageLayout oldLayout,
                            VkImageLayout newLayout, VkCommandPool commandPool,
-                           VkDevice device, VkQueue graphicsQueue);
+                           VkDevice device, VkQueue graphicsQueue,
+                           uint32_t mipLevels = 1);
 
 }; // namespace vkinit
@@ -0,0 +1,264 @@
+#include "./mapFile.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+// the tiles a chunk holds after clipping to the map edge
+void chunkExtent(int width, int height, int chunkX, int chunkY, int &columns,
+                 int &rows) {
+  columns = std::min(Tilemap::chunkSize, width - chunkX * Tilemap::chunkSize);
+  rows = std::min(Tilemap::chunkSize, height - chunkY * Tilemap::chunkSize);
+}
+
+// empties a corrupt chunk through row(), which leaves the dirty tracking
+// alone
+void clearChunk(Tilemap &tilemap, int originX, int originY, int columns,
+                int rows) {
+  for (int y = 0; y < rows; y++) {
+    std::fill_n(tilemap.row(originY + y) + originX, columns, Tile{0});
+  }
+}
+
+} // namespace
+
+bool mapfile::parse(const texfile::MappedFile &file, MapView &view) {
+  if (file.data() == nullptr || file.size() < sizeof(Header)) {
+    return false;
+  }
+
+  const Header *header = reinterpret_cast<const Header *>(file.data());
+  if (header->magic != fileMagic || header->version != fileVersion ||
+      header->chunkSize != static_cast<uint32_t>(Tilemap::chunkSize) ||
+      header->width == 0 || header->height == 0 ||
+      header->width > maxMapSize || header->height > maxMapSize) {
+    return false;
+  }
+
+  uint64_t chunksX = (uint64_t(header->width) + Tilemap::chunkSize - 1) /
+                     Tilemap::chunkSize;
+  uint64_t chunksY = (uint64_t(header->height) + Tilemap::chunkSize - 1) /
+                     Tilemap::chunkSize;
+  if (header->chunkCount != chunksX * chunksY) {
+    return false;
+  }
+
+  // sizes are compared against what is left, so no sum can wrap
+  uint64_t tableEnd =
+      sizeof(Header) + uint64_t(header->chunkCount) * sizeof(ChunkEntry);
+  if (tableEnd > file.size() || header->payloadOffset < tableEnd ||
+      header->payloadOffset > file.size() ||
+      header->payloadSize > file.size() - header->payloadOffset) {
+    return false;
+  }
+
+  const ChunkEntry *chunks =
+      reinterpret_cast<const ChunkEntry *>(file.data() + sizeof(Header));
+  for (uint32_t i = 0; i < header->chunkCount; i++) {
+    if (chunks[i].offset > header->payloadSize ||
+        chunks[i].size > header->payloadSize - chunks[i].offset) {
+      return false;
+    }
+  }
+
+  view.header = header;
+  view.chunks = chunks;
+  view.payload = file.data() + header->payloadOffset;
+  return true;
+}
+
+bool mapfile::decodeChunk(const MapView &view, uint32_t chunk,
+                          Tilemap &tilemap) {
+  int chunksX = tilemap.chunksX();
+  int chunkX = static_cast<int>(chunk % chunksX);
+  int chunkY = static_cast<int>(chunk / chunksX);
+  int columns, rows;
+  chunkExtent(tilemap.width(), tilemap.height(), chunkX, chunkY, columns,
+              rows);
+  int originX = chunkX * Tilemap::chunkSize;
+  int originY = chunkY * Tilemap::chunkSize;
+
+  const ChunkEntry &entry = view.chunks[chunk];
+  const uint8_t *data = view.payload + entry.offset;
+  size_t tileCount = static_cast<size_t>(columns) * rows;
+
+  if (entry.encoding == encodingRaw) {
+    if (entry.size != tileCount * sizeof(Tile)) {
+      clearChunk(tilemap, originX, originY, columns, rows);
+      return false;
+    }
+    for (int y = 0; y < rows; y++) {
+      memcpy(tilemap.row(originY + y) + originX,
+             data + static_cast<size_t>(y) * columns * sizeof(Tile),
+             columns * sizeof(Tile));
+    }
+    return true;
+  }
+
+  if (entry.encoding != encodingRuns || entry.size % sizeof(Run) != 0) {
+    clearChunk(tilemap, originX, originY, columns, rows);
+    return false;
+  }
+
+  // runs continue across rows; expanded into a contiguous chunk first, so
+  // short runs are plain fills, then copied out a row at a time
+  Tile tiles[Tilemap::chunkSize * Tilemap::chunkSize];
+  size_t runCount = entry.size / sizeof(Run);
+  size_t filled = 0;
+  for (size_t i = 0; i < runCount; i++) {
+    // the payload is only 2-byte aligned relative to the mapping
+    Run run;
+    memcpy(&run, data + i * sizeof(Run), sizeof(Run));
+    if (run.count > tileCount - filled) {
+      filled = tileCount + 1;
+      break;
+    }
+    std::fill_n(tiles + filled, run.count, Tile{run.type});
+    filled += run.count;
+  }
+
+  if (filled != tileCount) {
+    clearChunk(tilemap, originX, originY, columns, rows);
+    return false;
+  }
+  for (int y = 0; y < rows; y++) {
+    memcpy(tilemap.row(originY + y) + originX, tiles + y * columns,
+           columns * sizeof(Tile));
+  }
+  return true;
+}
+
+mapfile::Encoding mapfile::encodeChunk(const Tilemap &tilemap, int chunkX,
+                                       int chunkY, std::vector<uint8_t> &out) {
+  int columns, rows;
+  chunkExtent(tilemap.width(), tilemap.height(), chunkX, chunkY, columns,
+              rows);
+  int originX = chunkX * Tilemap::chunkSize;
+  int originY = chunkY * Tilemap::chunkSize;
+  size_t rawSize = static_cast<size_t>(columns) * rows * sizeof(Tile);
+
+  // a chunk is at most 1024 tiles, every run count fits 16 bits. Runs are
+  // counted first, stopping as soon as they are no smaller than the raw
+  // tiles, then written straight into out.
+  size_t runCount = 1;
+  uint16_t previous = tilemap.row(originY)[originX].type;
+  for (int y = 0; y < rows && runCount * sizeof(Run) < rawSize; y++) {
+    const Tile *row = tilemap.row(originY + y) + originX;
+    for (int x = 0; x < columns; x++) {
+      runCount += row[x].type != previous ? 1 : 0;
+      previous = row[x].type;
+    }
+  }
+
+  size_t start = out.size();
+  if (runCount * sizeof(Run) >= rawSize) {
+    out.resize(start + rawSize);
+    for (int y = 0; y < rows; y++) {
+      memcpy(out.data() + start + static_cast<size_t>(y) * columns *
+                                      sizeof(Tile),
+             tilemap.row(originY + y) + originX, columns * sizeof(Tile));
+    }
+    return encodingRaw;
+  }
+
+  out.resize(start + runCount * sizeof(Run));
+  uint8_t *next = out.data() + start;
+  Run run{0, tilemap.row(originY)[originX].type};
+  for (int y = 0; y < rows; y++) {
+    const Tile *row = tilemap.row(originY + y) + originX;
+    for (int x = 0; x < columns; x++) {
+      if (row[x].type != run.type) {
+        memcpy(next, &run, sizeof(Run));
+        next += sizeof(Run);
+        run = {0, row[x].type};
+      }
+      run.count++;
+    }
+  }
+  memcpy(next, &run, sizeof(Run));
+  return encodingRuns;
+}
+
+bool mapfile::load(const std::string &path, Tilemap &tilemap) {
+  texfile::MappedFile file;
+  MapView view;
+  if (!file.open(path) || !parse(file, view)) {
+    return false;
+  }
+
+  Tilemap loaded(static_cast<int>(view.header->width),
+                 static_cast<int>(view.header->height));
+  for (uint32_t chunk = 0; chunk < view.header->chunkCount; chunk++) {
+    if (!decodeChunk(view, chunk, loaded)) {
+      return false;
+    }
+  }
+  tilemap = std::move(loaded);
+  return true;
+}
+
+bool mapfile::write(const std::string &path, const Tilemap &tilemap) {
+  if (tilemap.width() == 0 || tilemap.height() == 0 ||
+      static_cast<uint32_t>(tilemap.width()) > maxMapSize ||
+      static_cast<uint32_t>(tilemap.height()) > maxMapSize) {
+    return false;
+  }
+
+  Header header{};
+  header.magic = fileMagic;
+  header.version = fileVersion;
+  header.width = static_cast<uint32_t>(tilemap.width());
+  header.height = static_cast<uint32_t>(tilemap.height());
+  header.chunkSize = Tilemap::chunkSize;
+  header.chunkCount =
+      static_cast<uint32_t>(tilemap.chunksX() * tilemap.chunksY());
+
+  uint64_t tableEnd =
+      sizeof(Header) + uint64_t(header.chunkCount) * sizeof(ChunkEntry);
+  header.payloadOffset =
+      (tableEnd + payloadAlignment - 1) & ~(payloadAlignment - 1);
+
+  // written next to the old file and renamed, a failed save leaves the
+  // previous map intact
+  std::string tempPath = path + ".tmp";
+  std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  // the payload is written a chunk at a time after room for the header and
+  // table, which are filled in once every chunk's offset is known
+  std::vector<char> padding(header.payloadOffset, 0);
+  file.write(padding.data(), header.payloadOffset);
+
+  std::vector<ChunkEntry> table(header.chunkCount);
+  std::vector<uint8_t> encoded;
+  uint64_t offset = 0;
+  for (int chunkY = 0; chunkY < tilemap.chunksY(); chunkY++) {
+    for (int chunkX = 0; chunkX < tilemap.chunksX(); chunkX++) {
+      encoded.clear();
+      ChunkEntry &entry = table[chunkY * tilemap.chunksX() + chunkX];
+      entry.offset = offset;
+      entry.encoding = encodeChunk(tilemap, chunkX, chunkY, encoded);
+      entry.size = static_cast<uint32_t>(encoded.size());
+      file.write(reinterpret_cast<const char *>(encoded.data()),
+                 encoded.size());
+      offset += encoded.size();
+    }
+  }
+  header.payloadSize = offset;
+
+  file.seekp(0);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(table.data()),
+             table.size() * sizeof(ChunkEntry));
+
+  file.close();
+  if (!file.good()) {
+    std::remove(tempPath.c_str());
+    return false;
+  }
+  return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "./textureFile.hpp"
+#include "./tilemap.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Tilemap container (.vmap). Each Tilemap::chunkSize chunk is stored on its
+// own, so a mapped file can be decoded a chunk at a time as the camera gets
+// near it. A chunk's tiles are row-major and clipped to the map edge, as
+// runs or, when runs would not be smaller, as raw tiles.
+//
+// layout: Header | ChunkEntry[chunksX * chunksY] | payload
+namespace mapfile {
+
+constexpr uint32_t fileMagic = 0x50414d56; // "VMAP"
+constexpr uint32_t fileVersion = 1;
+constexpr uint64_t payloadAlignment = 16;
+// the world is at most 4096x4096 tiles, anything larger is rejected
+constexpr uint32_t maxMapSize = 4096;
+
+enum Encoding : uint32_t {
+  encodingRaw = 0, // uint16_t type per tile
+  encodingRuns = 1, // Run per run of equal tiles
+};
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint32_t chunkSize;
+  uint32_t chunkCount;
+  uint64_t payloadOffset;
+  uint64_t payloadSize;
+};
+
+struct ChunkEntry {
+  uint64_t offset; // relative to payloadOffset
+  uint32_t size;
+  uint32_t encoding;
+};
+
+struct Run {
+  uint16_t count;
+  uint16_t type;
+};
+
+struct MapView {
+  const Header *header = nullptr;
+  const ChunkEntry *chunks = nullptr;
+  const uint8_t *payload = nullptr;
+};
+
+// validates the header and chunk table against the mapped size
+bool parse(const texfile::MappedFile &file, MapView &view);
+
+// Writes chunk (chunkY * chunksX + chunkX) straight into the tilemap's rows,
+// which must match the header's size. Does not mark it dirty. False on a
+// corrupt chunk, which is left empty.
+bool decodeChunk(const MapView &view, uint32_t chunk, Tilemap &tilemap);
+
+// appends the chunk's encoded tiles to out, returns the encoding used
+Encoding encodeChunk(const Tilemap &tilemap, int chunkX, int chunkY,
+                     std::vector<uint8_t> &out);
+
+// whole map at once, for tools and saving
+bool load(const std::string &path, Tilemap &tilemap);
+bool write(const std::string &path, const Tilemap &tilemap);
+
+}; // namespace mapfile
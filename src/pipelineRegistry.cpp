@@ -0,0 +1,546 @@
+#include "./pipelineRegistry.hpp"
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint64_t fnvOffset = 0xcbf29ce484222325ull;
+constexpr uint64_t fnvPrime = 0x100000001b3ull;
+
+uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= fnvPrime;
+  }
+  return hash;
+}
+
+template <typename T> uint64_t hashValue(uint64_t hash, const T &value) {
+  return hashBytes(hash, &value, sizeof(value));
+}
+
+bool sameCode(const ShaderCode &a, const ShaderCode &b) {
+  return a.wordCount == b.wordCount &&
+         (a.words == b.words || memcmp(a.words, b.words, a.size()) == 0);
+}
+
+std::vector<char> readBinary(const std::string &path) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    return {};
+  }
+  std::vector<char> data(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(data.data(), data.size());
+  return data;
+}
+
+} // namespace
+
+uint64_t PipelineDesc::hash() const {
+  uint64_t h = fnvOffset;
+  // the code itself, so an edited shader gets a new key
+  h = hashValue(h, vert.wordCount);
+  h = hashBytes(h, vert.words, vert.size());
+  h = hashValue(h, frag.wordCount);
+  h = hashBytes(h, frag.words, frag.size());
+  h = hashValue(h, constants.size());
+  for (const auto &constant : constants) {
+    h = hashValue(h, constant.id);
+    h = hashValue(h, constant.value);
+  }
+  h = hashValue(h, bindings.size());
+  for (const auto &binding : bindings) {
+    h = hashValue(h, binding.binding);
+    h = hashValue(h, binding.stride);
+    h = hashValue(h, binding.inputRate);
+  }
+  h = hashValue(h, attributes.size());
+  for (const auto &attribute : attributes) {
+    h = hashValue(h, attribute.location);
+    h = hashValue(h, attribute.binding);
+    h = hashValue(h, attribute.format);
+    h = hashValue(h, attribute.offset);
+  }
+  h = hashValue(h, topology);
+  h = hashValue(h, alphaBlend);
+  h = hashValue(h, depthTest);
+  h = hashValue(h, depthWrite);
+  h = hashValue(h, colorFormat);
+  h = hashValue(h, depthFormat);
+  return h;
+}
+
+bool PipelineDesc::operator==(const PipelineDesc &other) const {
+  if (!sameCode(vert, other.vert) || !sameCode(frag, other.frag) ||
+      constants.size() != other.constants.size() ||
+      bindings.size() != other.bindings.size() ||
+      attributes.size() != other.attributes.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < constants.size(); i++) {
+    if (constants[i].id != other.constants[i].id ||
+        constants[i].value != other.constants[i].value) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < bindings.size(); i++) {
+    const auto &a = bindings[i];
+    const auto &b = other.bindings[i];
+    if (a.binding != b.binding || a.stride != b.stride ||
+        a.inputRate != b.inputRate) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < attributes.size(); i++) {
+    const auto &a = attributes[i];
+    const auto &b = other.attributes[i];
+    if (a.location != b.location || a.binding != b.binding ||
+        a.format != b.format || a.offset != b.offset) {
+      return false;
+    }
+  }
+  return topology == other.topology && alphaBlend == other.alphaBlend &&
+         depthTest == other.depthTest && depthWrite == other.depthWrite &&
+         colorFormat == other.colorFormat &&
+         depthFormat == other.depthFormat && layout == other.layout;
+}
+
+void PipelineRegistry::init(VkDevice device, VkPhysicalDevice physicalDevice,
+                            ThreadPool &threadPool,
+                            const std::string &cachePath,
+                            const std::string &warmupPath) {
+  _device = device;
+  _threadPool = &threadPool;
+  _cachePath = cachePath;
+  _warmupPath = warmupPath;
+  vkGetPhysicalDeviceProperties(physicalDevice, &_properties);
+
+  // a damaged line is skipped, the pipeline just compiles on first use
+  std::ifstream warmupFile(warmupPath);
+  std::string line;
+  while (std::getline(warmupFile, line)) {
+    const char *end = line.data() + line.size();
+    PipelineKey key = 0;
+    auto parsed = std::from_chars(line.data(), end, key, 16);
+    if (parsed.ec == std::errc() && parsed.ptr == end && !line.empty()) {
+      _warmup.insert(key);
+    }
+  }
+
+  std::vector<char> file = readBinary(cachePath);
+  std::vector<char> data;
+  if (file.size() >= sizeof(FileHeader)) {
+    FileHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (header.magic == fileMagic && header.version == fileVersion &&
+        header.driverVersion == _properties.driverVersion &&
+        header.dataSize == file.size() - sizeof(FileHeader)) {
+      data.assign(file.begin() + sizeof(FileHeader), file.end());
+    }
+  }
+
+  // a cache from another GPU or driver is dropped instead of being handed to
+  // the driver, which would either ignore it or worse
+  _cacheLoaded = !data.empty() && validCacheData(data);
+  if (!_cacheLoaded) {
+    data.clear();
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+  if (vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_cache) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache");
+  }
+}
+
+bool PipelineRegistry::validCacheData(const std::vector<char> &data) const {
+  VkPipelineCacheHeaderVersionOne header;
+  if (data.size() < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+
+  return header.headerSize >= sizeof(header) &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == _properties.vendorID &&
+         header.deviceID == _properties.deviceID &&
+         memcmp(header.pipelineCacheUUID, _properties.pipelineCacheUUID,
+                VK_UUID_SIZE) == 0;
+}
+
+void PipelineRegistry::save() const {
+  if (_cache == VK_NULL_HANDLE) {
+    return;
+  }
+
+  std::ofstream warmupFile(_warmupPath, std::ios::trunc);
+  for (PipelineKey key : _used) {
+    warmupFile << std::hex << key << "\n";
+  }
+
+  size_t size = 0;
+  if (vkGetPipelineCacheData(_device, _cache, &size, nullptr) != VK_SUCCESS ||
+      size == 0) {
+    return;
+  }
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(_device, _cache, &size, data.data()) !=
+      VK_SUCCESS) {
+    return;
+  }
+
+  FileHeader header{};
+  header.magic = fileMagic;
+  header.version = fileVersion;
+  header.driverVersion = _properties.driverVersion;
+  header.dataSize = static_cast<uint32_t>(size);
+
+  // written next to the old file and renamed, a crash mid-write leaves the
+  // previous cache intact
+  std::string tempPath = _cachePath + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      std::cout << "failed to write pipeline cache " << tempPath << "\n";
+      return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(data.data(), static_cast<std::streamsize>(size));
+    if (!file.good()) {
+      return;
+    }
+  }
+  std::rename(tempPath.c_str(), _cachePath.c_str());
+}
+
+void PipelineRegistry::destroy() {
+  while (_pendingCompiles > 0) {
+    finishCompile(_compiled.waitPop());
+  }
+
+  for (auto &entry : _pipelines) {
+    if (entry.second.pipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(_device, entry.second.pipeline, nullptr);
+    }
+  }
+  _pipelines.clear();
+
+  if (_cache != VK_NULL_HANDLE) {
+    vkDestroyPipelineCache(_device, _cache, nullptr);
+    _cache = VK_NULL_HANDLE;
+  }
+}
+
+VkPipeline PipelineRegistry::get(const PipelineDesc &desc) {
+  PipelineKey key = declare(desc);
+  Entry &entry = _pipelines.at(key);
+
+  while (entry.state == State::Compiling) {
+    finishCompile(_compiled.waitPop());
+  }
+
+  if (entry.state == State::Declared) {
+    auto start = std::chrono::high_resolution_clock::now();
+    entry.pipeline = create(desc);
+    _createMilliseconds +=
+        std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start)
+            .count();
+    _createdCount++;
+    entry.state = State::Ready;
+  }
+
+  if (entry.state != State::Ready) {
+    throw std::runtime_error(
+        std::string("failed to create graphics pipeline ") + desc.vert.name);
+  }
+  _used.insert(key);
+  return entry.pipeline;
+}
+
+PipelineKey PipelineRegistry::declare(const PipelineDesc &desc) {
+  PipelineKey key = desc.hash();
+  auto inserted = _pipelines.try_emplace(key);
+  if (!inserted.second) {
+    // the 64-bit key alone would silently hand back another pipeline
+    if (!(inserted.first->second.desc == desc)) {
+      throw std::runtime_error(
+          std::string("pipeline key collision for ") + desc.vert.name);
+    }
+    return key;
+  }
+
+  inserted.first->second.desc = desc;
+  if (_warmup.count(key) != 0) {
+    _pendingWarmup++;
+    compileAsync(key, inserted.first->second);
+  }
+  return key;
+}
+
+VkPipeline PipelineRegistry::request(PipelineKey key) {
+  auto found = _pipelines.find(key);
+  if (found == _pipelines.end()) {
+    return VK_NULL_HANDLE;
+  }
+
+  Entry &entry = found->second;
+  if (entry.state == State::Declared) {
+    compileAsync(key, entry);
+  }
+  if (entry.state != State::Ready) {
+    return VK_NULL_HANDLE;
+  }
+  _used.insert(key);
+  return entry.pipeline;
+}
+
+void PipelineRegistry::compileAsync(PipelineKey key, Entry &entry) {
+  entry.state = State::Compiling;
+  _pendingCompiles++;
+
+  // the job works on a copy, _pipelines belongs to the render thread
+  _threadPool->submit([this, key, desc = entry.desc] {
+    Compiled compiled;
+    compiled.key = key;
+    auto start = std::chrono::high_resolution_clock::now();
+    try {
+      compiled.pipeline = create(desc);
+    } catch (const std::exception &e) {
+      std::cout << e.what() << "\n";
+    }
+    compiled.milliseconds =
+        std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start)
+            .count();
+    _compiled.push(std::move(compiled));
+  });
+}
+
+void PipelineRegistry::finishCompile(const Compiled &compiled) {
+  _pendingCompiles--;
+  if (_warmup.count(compiled.key) != 0 && _pendingWarmup > 0) {
+    _pendingWarmup--;
+  }
+
+  Entry &entry = _pipelines.at(compiled.key);
+  entry.pipeline = compiled.pipeline;
+  entry.state =
+      compiled.pipeline != VK_NULL_HANDLE ? State::Ready : State::Failed;
+  if (entry.state == State::Ready) {
+    _createdCount++;
+    _createMilliseconds += compiled.milliseconds;
+  }
+}
+
+void PipelineRegistry::poll() {
+  Compiled compiled;
+  while (_compiled.tryPop(compiled)) {
+    finishCompile(compiled);
+  }
+}
+
+void PipelineRegistry::finishWarmup() {
+  while (_pendingWarmup > 0) {
+    finishCompile(_compiled.waitPop());
+  }
+}
+
+VkShaderModule
+PipelineRegistry::createShaderModule(const ShaderCode &code) const {
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = code.size();
+  createInfo.pCode = code.words;
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(_device, &createInfo, nullptr, &shaderModule) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module");
+  }
+  return shaderModule;
+}
+
+VkPipeline PipelineRegistry::create(const PipelineDesc &desc) const {
+  VkShaderModule vertShaderModule = createShaderModule(desc.vert);
+  VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+  try {
+    fragShaderModule = createShaderModule(desc.frag);
+  } catch (...) {
+    vkDestroyShaderModule(_device, vertShaderModule, nullptr);
+    throw;
+  }
+
+  std::vector<VkSpecializationMapEntry> mapEntries(desc.constants.size());
+  std::vector<uint32_t> constantData(desc.constants.size());
+  for (size_t i = 0; i < desc.constants.size(); i++) {
+    mapEntries[i].constantID = desc.constants[i].id;
+    mapEntries[i].offset = static_cast<uint32_t>(i * sizeof(uint32_t));
+    mapEntries[i].size = sizeof(uint32_t);
+    constantData[i] = desc.constants[i].value;
+  }
+
+  VkSpecializationInfo specializationInfo{};
+  specializationInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+  specializationInfo.pMapEntries = mapEntries.data();
+  specializationInfo.dataSize = constantData.size() * sizeof(uint32_t);
+  specializationInfo.pData = constantData.data();
+  const VkSpecializationInfo *specialization =
+      desc.constants.empty() ? nullptr : &specializationInfo;
+
+  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+  vertShaderStageInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  vertShaderStageInfo.module = vertShaderModule;
+  vertShaderStageInfo.pName = "main";
+  vertShaderStageInfo.pSpecializationInfo = specialization;
+
+  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+  fragShaderStageInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  fragShaderStageInfo.module = fragShaderModule;
+  fragShaderStageInfo.pName = "main";
+  fragShaderStageInfo.pSpecializationInfo = specialization;
+
+  VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo,
+                                                    fragShaderStageInfo};
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  vertexInputInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(desc.bindings.size());
+  vertexInputInfo.pVertexBindingDescriptions = desc.bindings.data();
+  vertexInputInfo.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(desc.attributes.size());
+  vertexInputInfo.pVertexAttributeDescriptions = desc.attributes.data();
+
+  std::vector<VkDynamicState> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT,
+                                               VK_DYNAMIC_STATE_SCISSOR};
+
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates = dynamicStates.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+  inputAssembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = desc.topology;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  // viewport and scissor are set when recording
+  VkPipelineViewportStateCreateInfo viewportState{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.depthBiasEnable = VK_FALSE;
+  rasterizer.depthBiasConstantFactor = 0.0f;
+  rasterizer.depthBiasClamp = 0.0f;
+  rasterizer.depthBiasSlopeFactor = 0.0f;
+  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.minSampleShading = 1.0f;
+  multisampling.pSampleMask = nullptr;
+  multisampling.alphaToCoverageEnable = VK_FALSE;
+  multisampling.alphaToOneEnable = VK_FALSE;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+  colorBlendAttachment.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = desc.alphaBlend ? VK_TRUE : VK_FALSE;
+  colorBlendAttachment.srcColorBlendFactor =
+      desc.alphaBlend ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.dstColorBlendFactor =
+      desc.alphaBlend ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA
+                      : VK_BLEND_FACTOR_ZERO;
+  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending{};
+  colorBlending.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable = VK_FALSE;
+  colorBlending.logicOp = VK_LOGIC_OP_COPY;
+  colorBlending.attachmentCount = 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  // equal depth passes so draws within one layer keep painter's order
+  VkPipelineDepthStencilStateCreateInfo depthStencil{};
+  depthStencil.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+  depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.stencilTestEnable = VK_FALSE;
+  depthStencil.minDepthBounds = 0.0f;
+  depthStencil.maxDepthBounds = 1.0f;
+
+  VkPipelineRenderingCreateInfo renderingCreateInfo{};
+  renderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+  renderingCreateInfo.colorAttachmentCount = 1;
+  renderingCreateInfo.pColorAttachmentFormats = &desc.colorFormat;
+  renderingCreateInfo.depthAttachmentFormat = desc.depthFormat;
+  renderingCreateInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = &renderingCreateInfo;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = desc.layout;
+  pipelineInfo.renderPass = VK_NULL_HANDLE;
+  pipelineInfo.subpass = 0;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult result = vkCreateGraphicsPipelines(_device, _cache, 1,
+                                              &pipelineInfo, nullptr,
+                                              &pipeline);
+
+  vkDestroyShaderModule(_device, fragShaderModule, nullptr);
+  vkDestroyShaderModule(_device, vertShaderModule, nullptr);
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error(
+        std::string("failed to create graphics pipeline ") + desc.vert.name);
+  }
+  return pipeline;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "./shaderCode.hpp"
+#include "./threadPool.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+// Everything that makes two graphics pipelines different. Viewport and
+// scissor are dynamic and not part of it.
+struct PipelineDesc {
+  // a 32-bit specialization constant (uint, int, float or bool)
+  struct Constant {
+    uint32_t id = 0;
+    uint32_t value = 0;
+  };
+
+  ShaderCode vert;
+  ShaderCode frag;
+  // given to both stages, ids a stage does not declare are ignored by it;
+  // constants left out keep the default from the GLSL source
+  std::vector<Constant> constants;
+  std::vector<VkVertexInputBindingDescription> bindings;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  bool alphaBlend = false;
+  bool depthTest = false;
+  bool depthWrite = false;
+  VkFormat colorFormat = VK_FORMAT_B8G8R8A8_SRGB;
+  VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+
+  // FNV-1a over every field but the layout, whose handle changes every run;
+  // the hash is the registry key and what the warmup list stores
+  uint64_t hash() const;
+  // every field, the layout included; tells a hash collision from a repeat
+  bool operator==(const PipelineDesc &other) const;
+};
+
+using PipelineKey = uint64_t;
+
+// Owns every graphics pipeline, created once per unique PipelineDesc through
+// a VkPipelineCache that is persisted between runs.
+//
+// Pipelines that are only declared compile on the thread pool the first time
+// they are asked for; until then the caller draws with a fallback or skips
+// the draw. Keys used in a session are written to a warmup list and
+// compiled right away when declared in the next one.
+//
+// cache file: FileHeader | vkGetPipelineCacheData blob
+// warmup file: one hex key per line
+class PipelineRegistry {
+public:
+  static constexpr uint32_t fileMagic = 0x434c5056; // "VPLC"
+  static constexpr uint32_t fileVersion = 1;
+
+  struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t driverVersion;
+    uint32_t dataSize;
+  };
+
+  // loads the cache from cachePath and the warmup list from warmupPath, a
+  // missing or stale file starts empty
+  void init(VkDevice device, VkPhysicalDevice physicalDevice,
+            ThreadPool &threadPool, const std::string &cachePath,
+            const std::string &warmupPath);
+  void save() const;
+  // waits for compiles still in flight, then destroys every pipeline
+  void destroy();
+
+  // returns the existing pipeline for desc or creates it on this thread
+  VkPipeline get(const PipelineDesc &desc);
+
+  // registers desc without compiling it, unless it is on the warmup list;
+  // throws if a different desc already holds the same key
+  PipelineKey declare(const PipelineDesc &desc);
+  // the pipeline once compiled, VK_NULL_HANDLE while it is pending; the first
+  // call queues the compile
+  VkPipeline request(PipelineKey key);
+
+  // render thread, once per frame: picks up finished compiles
+  void poll();
+  // blocks until the warmup compiles queued by declare() are done
+  void finishWarmup();
+
+  VkPipelineCache cache() const { return _cache; }
+  bool cacheLoaded() const { return _cacheLoaded; }
+  uint32_t createdCount() const { return _createdCount; }
+  uint32_t pendingCount() const { return _pendingCompiles; }
+  double createMilliseconds() const { return _createMilliseconds; }
+
+private:
+  enum class State { Declared, Compiling, Ready, Failed };
+
+  struct Entry {
+    PipelineDesc desc;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    State state = State::Declared;
+  };
+
+  struct Compiled {
+    PipelineKey key = 0;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    double milliseconds = 0.0;
+  };
+
+  VkPipeline create(const PipelineDesc &desc) const;
+  VkShaderModule createShaderModule(const ShaderCode &code) const;
+  bool validCacheData(const std::vector<char> &data) const;
+  void compileAsync(PipelineKey key, Entry &entry);
+  void finishCompile(const Compiled &compiled);
+
+  VkDevice _device = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties _properties{};
+  ThreadPool *_threadPool = nullptr;
+  // internally synchronized, the workers share it without a lock
+  VkPipelineCache _cache = VK_NULL_HANDLE;
+  std::string _cachePath;
+  std::string _warmupPath;
+  bool _cacheLoaded = false;
+
+  // render thread only, workers report through _compiled
+  std::unordered_map<PipelineKey, Entry> _pipelines;
+  std::unordered_set<PipelineKey> _warmup;
+  std::unordered_set<PipelineKey> _used;
+  CompletionQueue<Compiled> _compiled;
+  uint32_t _pendingCompiles = 0;
+  uint32_t _pendingWarmup = 0;
+  uint32_t _createdCount = 0;
+  double _createMilliseconds = 0.0;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// SPIR-V compiled and embedded at build time (cmake/embedSpirv.cmake), the
+// words are handed to vkCreateShaderModule as they are. Every shader is
+// reachable through "embeddedShaders.hpp" as embeddedShaders::<file>_<stage>,
+// e.g. embeddedShaders::shader_vert.
+struct ShaderCode {
+  const char *name = nullptr; // source file name, e.g. "shader.vert"
+  const uint32_t *words = nullptr;
+  size_t wordCount = 0;
+
+  size_t size() const { return wordCount * sizeof(uint32_t); }
+};
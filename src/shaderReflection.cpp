@@ -0,0 +1,578 @@
+#include "./shaderReflection.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr uint32_t spirvMagic = 0x07230203;
+constexpr uint32_t headerWords = 5;
+
+// the subset of the SPIR-V spec the engine's shaders need
+enum Op : uint32_t {
+  OpEntryPoint = 15,
+  OpTypeBool = 20,
+  OpTypeInt = 21,
+  OpTypeFloat = 22,
+  OpTypeVector = 23,
+  OpTypeMatrix = 24,
+  OpTypeImage = 25,
+  OpTypeSampler = 26,
+  OpTypeSampledImage = 27,
+  OpTypeArray = 28,
+  OpTypeRuntimeArray = 29,
+  OpTypeStruct = 30,
+  OpTypePointer = 32,
+  OpConstant = 43,
+  OpVariable = 59,
+  OpDecorate = 71,
+  OpMemberDecorate = 72,
+};
+
+enum Decoration : uint32_t {
+  DecorationBlock = 2,
+  DecorationBufferBlock = 3,
+  DecorationArrayStride = 6,
+  DecorationMatrixStride = 7,
+  DecorationBuiltIn = 11,
+  DecorationLocation = 30,
+  DecorationBinding = 33,
+  DecorationDescriptorSet = 34,
+  DecorationOffset = 35,
+};
+
+enum StorageClass : uint32_t {
+  StorageUniformConstant = 0,
+  StorageInput = 1,
+  StorageUniform = 2,
+  StoragePushConstant = 9,
+  StorageStorageBuffer = 12,
+};
+
+enum ExecutionModel : uint32_t {
+  ModelVertex = 0,
+  ModelFragment = 4,
+  ModelGLCompute = 5,
+};
+
+constexpr uint32_t dimBuffer = 5;
+constexpr uint32_t dimSubpassData = 6;
+constexpr uint32_t none = ~0u;
+
+struct Id {
+  uint32_t opcode = 0;
+  // types: OpTypeInt/Float width, vector/matrix count, array length id,
+  // image dim; pointers and variables: storage class; constants: value
+  uint32_t value = 0;
+  uint32_t sampled = 0;   // OpTypeImage
+  uint32_t signedness = 0; // OpTypeInt
+  uint32_t type = none;   // element, column, pointee or variable type
+  std::vector<uint32_t> members;
+  std::vector<uint32_t> memberOffsets;
+  std::vector<uint32_t> memberMatrixStrides;
+
+  uint32_t set = none;
+  uint32_t binding = none;
+  uint32_t location = none;
+  uint32_t arrayStride = 0;
+  bool block = false;
+  bool bufferBlock = false;
+  bool builtIn = false;
+};
+
+struct Module {
+  std::vector<Id> ids;
+  VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+  const Id &at(uint32_t id) const {
+    if (id >= ids.size()) {
+      throw std::runtime_error("spirv id out of range");
+    }
+    return ids[id];
+  }
+
+  // byte size under the explicit layout decorations
+  uint32_t sizeOf(uint32_t typeId, uint32_t matrixStride = 0) const {
+    const Id &type = at(typeId);
+    switch (type.opcode) {
+    case OpTypeBool:
+      return 4;
+    case OpTypeInt:
+    case OpTypeFloat:
+      return type.value / 8;
+    case OpTypeVector:
+      return type.value * sizeOf(type.type);
+    case OpTypeMatrix:
+      return type.value *
+             (matrixStride != 0 ? matrixStride : sizeOf(type.type));
+    case OpTypeArray:
+      return at(type.value).value *
+             (type.arrayStride != 0 ? type.arrayStride : sizeOf(type.type));
+    case OpTypeStruct: {
+      uint32_t size = 0;
+      for (size_t i = 0; i < type.members.size(); i++) {
+        uint32_t end = type.memberOffsets[i] +
+                       sizeOf(type.members[i], type.memberMatrixStrides[i]);
+        size = std::max(size, end);
+      }
+      return size;
+    }
+    default:
+      throw std::runtime_error("spirv type without a size");
+    }
+  }
+
+  // scalar type under any vector/matrix nesting
+  const Id &scalarOf(uint32_t typeId) const {
+    const Id *type = &at(typeId);
+    while (type->opcode == OpTypeVector || type->opcode == OpTypeMatrix) {
+      type = &at(type->type);
+    }
+    return *type;
+  }
+};
+
+void parse(const ShaderCode &code, Module &module) {
+  const uint32_t *words = code.words;
+  if (code.wordCount < headerWords || words[0] != spirvMagic) {
+    throw std::runtime_error(std::string("not a spirv module: ") +
+                             (code.name != nullptr ? code.name : "?"));
+  }
+  module.ids.resize(words[3]); // id bound
+
+  bool entryPointFound = false;
+  for (size_t offset = headerWords; offset < code.wordCount;) {
+    uint32_t wordCount = words[offset] >> 16;
+    uint32_t opcode = words[offset] & 0xffff;
+    if (wordCount == 0 || offset + wordCount > code.wordCount) {
+      throw std::runtime_error("truncated spirv instruction");
+    }
+    const uint32_t *operands = words + offset + 1;
+
+    switch (opcode) {
+    case OpEntryPoint:
+      if (entryPointFound) {
+        throw std::runtime_error("spirv module with several entry points");
+      }
+      entryPointFound = true;
+      if (operands[0] == ModelVertex) {
+        module.stage = VK_SHADER_STAGE_VERTEX_BIT;
+      } else if (operands[0] == ModelFragment) {
+        module.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+      } else if (operands[0] == ModelGLCompute) {
+        module.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+      } else {
+        throw std::runtime_error("unsupported spirv execution model");
+      }
+      break;
+    case OpTypeBool:
+    case OpTypeSampler:
+      module.ids.at(operands[0]).opcode = opcode;
+      break;
+    case OpTypeInt:
+      module.ids.at(operands[0]).opcode = opcode;
+      module.ids.at(operands[0]).value = operands[1];
+      module.ids.at(operands[0]).signedness = operands[2];
+      break;
+    case OpTypeFloat:
+      module.ids.at(operands[0]).opcode = opcode;
+      module.ids.at(operands[0]).value = operands[1];
+      break;
+    case OpTypeVector:
+    case OpTypeMatrix:
+    case OpTypeArray: {
+      Id &id = module.ids.at(operands[0]);
+      id.opcode = opcode;
+      id.type = operands[1];
+      id.value = operands[2];
+      break;
+    }
+    case OpTypeRuntimeArray:
+    case OpTypeSampledImage: {
+      Id &id = module.ids.at(operands[0]);
+      id.opcode = opcode;
+      id.type = operands[1];
+      break;
+    }
+    case OpTypeImage: {
+      Id &id = module.ids.at(operands[0]);
+      id.opcode = opcode;
+      id.value = operands[2];   // dim
+      id.sampled = operands[6]; // 1 sampled, 2 storage
+      break;
+    }
+    case OpTypeStruct: {
+      Id &id = module.ids.at(operands[0]);
+      id.opcode = opcode;
+      id.members.assign(operands + 1, operands + wordCount - 1);
+      id.memberOffsets.resize(id.members.size(), 0);
+      id.memberMatrixStrides.resize(id.members.size(), 0);
+      break;
+    }
+    case OpTypePointer:
+    case OpVariable: {
+      // OpTypePointer: result, storage, type; OpVariable: type, result,
+      // storage
+      uint32_t result = opcode == OpTypePointer ? operands[0] : operands[1];
+      Id &id = module.ids.at(result);
+      id.opcode = opcode;
+      id.value = opcode == OpTypePointer ? operands[1] : operands[2];
+      id.type = opcode == OpTypePointer ? operands[2] : operands[0];
+      break;
+    }
+    case OpConstant:
+      module.ids.at(operands[1]).opcode = opcode;
+      module.ids.at(operands[1]).value = operands[2];
+      break;
+    case OpDecorate: {
+      Id &id = module.ids.at(operands[0]);
+      switch (operands[1]) {
+      case DecorationBlock:
+        id.block = true;
+        break;
+      case DecorationBufferBlock:
+        id.bufferBlock = true;
+        break;
+      case DecorationArrayStride:
+        id.arrayStride = operands[2];
+        break;
+      case DecorationBuiltIn:
+        id.builtIn = true;
+        break;
+      case DecorationLocation:
+        id.location = operands[2];
+        break;
+      case DecorationBinding:
+        id.binding = operands[2];
+        break;
+      case DecorationDescriptorSet:
+        id.set = operands[2];
+        break;
+      }
+      break;
+    }
+    default:
+      break;
+    }
+
+    offset += wordCount;
+  }
+
+  if (!entryPointFound) {
+    throw std::runtime_error("spirv module without an entry point");
+  }
+
+  // member decorations may precede the struct they refer to
+  for (size_t offset = headerWords; offset < code.wordCount;) {
+    uint32_t wordCount = words[offset] >> 16;
+    uint32_t opcode = words[offset] & 0xffff;
+    const uint32_t *operands = words + offset + 1;
+    if (opcode == OpMemberDecorate) {
+      Id &id = module.ids.at(operands[0]);
+      uint32_t member = operands[1];
+      if (member < id.members.size()) {
+        if (operands[2] == DecorationOffset) {
+          id.memberOffsets[member] = operands[3];
+        } else if (operands[2] == DecorationMatrixStride) {
+          id.memberMatrixStrides[member] = operands[3];
+        } else if (operands[2] == DecorationBuiltIn) {
+          id.builtIn = true;
+        }
+      }
+    }
+    offset += wordCount;
+  }
+}
+
+VkDescriptorType descriptorType(const Module &module, uint32_t storage,
+                                uint32_t typeId) {
+  const Id &type = module.at(typeId);
+  switch (type.opcode) {
+  case OpTypeSampledImage:
+    return module.at(type.type).value == dimBuffer
+               ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER
+               : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  case OpTypeSampler:
+    return VK_DESCRIPTOR_TYPE_SAMPLER;
+  case OpTypeImage:
+    if (type.value == dimSubpassData) {
+      return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    }
+    if (type.value == dimBuffer) {
+      return type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                               : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+    }
+    return type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                             : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+  case OpTypeStruct:
+    if (storage == StorageStorageBuffer || type.bufferBlock) {
+      return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+    return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  default:
+    throw std::runtime_error("unsupported spirv descriptor type");
+  }
+}
+
+bool formatIsInteger(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_R8_UINT:
+  case VK_FORMAT_R8G8B8A8_UINT:
+  case VK_FORMAT_R16_UINT:
+  case VK_FORMAT_R16G16_UINT:
+  case VK_FORMAT_R32_UINT:
+  case VK_FORMAT_R32G32_UINT:
+  case VK_FORMAT_R32G32B32_UINT:
+  case VK_FORMAT_R32G32B32A32_UINT:
+  case VK_FORMAT_R32_SINT:
+  case VK_FORMAT_R32G32_SINT:
+  case VK_FORMAT_R32G32B32_SINT:
+  case VK_FORMAT_R32G32B32A32_SINT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+ShaderReflection reflection::reflect(const ShaderCode &code) {
+  Module module;
+  parse(code, module);
+
+  ShaderReflection result;
+  result.stage = module.stage;
+
+  for (const Id &variable : module.ids) {
+    if (variable.opcode != OpVariable || variable.builtIn) {
+      continue;
+    }
+    uint32_t storage = variable.value;
+    const Id &pointer = module.at(variable.type);
+    uint32_t typeId = pointer.type;
+
+    if (storage == StoragePushConstant) {
+      result.pushConstantSize = module.sizeOf(typeId);
+      continue;
+    }
+
+    if (storage == StorageInput && module.stage == VK_SHADER_STAGE_VERTEX_BIT) {
+      if (variable.location == none || module.at(typeId).builtIn) {
+        continue;
+      }
+      const Id &type = module.at(typeId);
+      uint32_t columns = type.opcode == OpTypeMatrix ? type.value : 1;
+      const Id &column = type.opcode == OpTypeMatrix ? module.at(type.type)
+                                                     : type;
+      ShaderReflection::Input input;
+      input.components = column.opcode == OpTypeVector ? column.value : 1;
+      input.integer = module.scalarOf(typeId).opcode == OpTypeInt;
+      for (uint32_t i = 0; i < columns; i++) {
+        input.location = variable.location + i;
+        result.inputs.push_back(input);
+      }
+      continue;
+    }
+
+    if (storage != StorageUniformConstant && storage != StorageUniform &&
+        storage != StorageStorageBuffer) {
+      continue;
+    }
+    if (variable.binding == none) {
+      continue;
+    }
+
+    ShaderReflection::Binding binding;
+    binding.set = variable.set == none ? 0 : variable.set;
+    binding.binding = variable.binding;
+    const Id &type = module.at(typeId);
+    if (type.opcode == OpTypeArray) {
+      binding.count = module.at(type.value).value;
+      typeId = type.type;
+    } else if (type.opcode == OpTypeRuntimeArray) {
+      throw std::runtime_error("unsized descriptor arrays are not supported, "
+                               "give the array a length");
+    }
+    binding.type = descriptorType(module, storage, typeId);
+    result.bindings.push_back(binding);
+  }
+
+  std::sort(result.inputs.begin(), result.inputs.end(),
+            [](const auto &a, const auto &b) { return a.location < b.location; });
+  return result;
+}
+
+std::vector<VkVertexInputAttributeDescription> reflection::selectAttributes(
+    const ShaderReflection &vertex,
+    const std::vector<VkVertexInputAttributeDescription> &available) {
+  std::vector<VkVertexInputAttributeDescription> selected;
+  for (const auto &input : vertex.inputs) {
+    const VkVertexInputAttributeDescription *match = nullptr;
+    for (const auto &attribute : available) {
+      if (attribute.location == input.location &&
+          (match == nullptr || attribute.binding >= match->binding)) {
+        match = &attribute;
+      }
+    }
+    if (match == nullptr) {
+      throw std::runtime_error("vertex shader reads location " +
+                               std::to_string(input.location) +
+                               " but no vertex attribute provides it");
+    }
+    if (formatIsInteger(match->format) != input.integer) {
+      throw std::runtime_error("vertex attribute " +
+                               std::to_string(input.location) +
+                               " does not match the shader's numeric type");
+    }
+    selected.push_back(*match);
+  }
+  return selected;
+}
+
+void LayoutCache::destroy() {
+  for (auto &entry : _pipelineLayouts) {
+    vkDestroyPipelineLayout(_device, entry.second.layout, nullptr);
+  }
+  _pipelineLayouts.clear();
+  for (auto &entry : _setLayouts) {
+    vkDestroyDescriptorSetLayout(_device, entry.second, nullptr);
+  }
+  _setLayouts.clear();
+  _reflections.clear();
+}
+
+const ShaderReflection &LayoutCache::reflect(const ShaderCode &code) {
+  auto found = _reflections.find(code.words);
+  if (found == _reflections.end()) {
+    found = _reflections.emplace(code.words, reflection::reflect(code)).first;
+  }
+  return found->second;
+}
+
+const LayoutCache::PipelineLayout &
+LayoutCache::get(std::initializer_list<ShaderCode> stages) {
+  // set -> bindings, merged over the stages
+  std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> sets;
+  VkPushConstantRange pushConstants{};
+
+  for (const ShaderCode &code : stages) {
+    const ShaderReflection &stage = reflect(code);
+
+    for (const auto &binding : stage.bindings) {
+      auto &setBindings = sets[binding.set];
+      auto existing =
+          std::find_if(setBindings.begin(), setBindings.end(),
+                       [&](const VkDescriptorSetLayoutBinding &b) {
+                         return b.binding == binding.binding;
+                       });
+      if (existing == setBindings.end()) {
+        VkDescriptorSetLayoutBinding layoutBinding{};
+        layoutBinding.binding = binding.binding;
+        layoutBinding.descriptorType = binding.type;
+        layoutBinding.descriptorCount = binding.count;
+        layoutBinding.stageFlags = stage.stage;
+        setBindings.push_back(layoutBinding);
+      } else if (existing->descriptorType != binding.type ||
+                 existing->descriptorCount != binding.count) {
+        throw std::runtime_error(
+            "stages disagree on set " + std::to_string(binding.set) +
+            " binding " + std::to_string(binding.binding));
+      } else {
+        existing->stageFlags |= stage.stage;
+      }
+    }
+
+    // one range for every stage that pushes, sized by the largest block
+    if (stage.pushConstantSize > 0) {
+      pushConstants.stageFlags |= stage.stage;
+      pushConstants.size = std::max(pushConstants.size, stage.pushConstantSize);
+    }
+  }
+
+  // sets are indexed by number, holes get an empty layout
+  uint32_t setCount = sets.empty() ? 0 : sets.rbegin()->first + 1;
+  std::vector<VkDescriptorSetLayout> setLayouts(setCount);
+  for (uint32_t i = 0; i < setCount; i++) {
+    auto &bindings = sets[i];
+    std::sort(bindings.begin(), bindings.end(),
+              [](const auto &a, const auto &b) { return a.binding < b.binding; });
+    setLayouts[i] = setLayout(bindings);
+  }
+
+  std::vector<uint64_t> key;
+  for (VkDescriptorSetLayout layout : setLayouts) {
+    key.push_back((uint64_t)layout);
+  }
+  key.push_back(pushConstants.stageFlags);
+  key.push_back(pushConstants.size);
+
+  auto found = _pipelineLayouts.find(key);
+  if (found != _pipelineLayouts.end()) {
+    return found->second;
+  }
+
+  PipelineLayout result;
+  result.setLayouts = setLayouts;
+  result.pushConstants = pushConstants;
+
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+  layoutInfo.pSetLayouts = setLayouts.data();
+  layoutInfo.pushConstantRangeCount = pushConstants.size > 0 ? 1 : 0;
+  layoutInfo.pPushConstantRanges = &pushConstants;
+
+  if (vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &result.layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout");
+  }
+  return _pipelineLayouts.emplace(key, result).first->second;
+}
+
+VkDescriptorSetLayout LayoutCache::setLayout(
+    const std::vector<VkDescriptorSetLayoutBinding> &bindings) {
+  std::vector<uint64_t> key;
+  for (const auto &binding : bindings) {
+    key.push_back(binding.binding);
+    key.push_back(binding.descriptorType);
+    key.push_back(binding.descriptorCount);
+    key.push_back(binding.stageFlags);
+  }
+
+  auto found = _setLayouts.find(key);
+  if (found != _setLayouts.end()) {
+    return found->second;
+  }
+
+  // texture slots are filled as textures become resident, while earlier
+  // frames that never sample them may still be in flight
+  std::vector<VkDescriptorBindingFlags> bindingFlags(bindings.size(), 0);
+  bool bindless = false;
+  for (size_t i = 0; i < bindings.size(); i++) {
+    if (bindings[i].descriptorCount > 1) {
+      bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+      bindless = true;
+    }
+  }
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+  bindingFlagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+  bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = bindless ? &bindingFlagsInfo : nullptr;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor set layout");
+  }
+  _setLayouts.emplace(key, layout);
+  return layout;
+}
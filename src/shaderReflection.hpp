@@ -0,0 +1,82 @@
+#pragma once
+
+#include "./shaderCode.hpp"
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+// Interface of one shader stage, read straight from its SPIR-V.
+struct ShaderReflection {
+  struct Binding {
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    VkDescriptorType type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    uint32_t count = 1;
+  };
+
+  // one per location, a matrix input takes one location per column
+  struct Input {
+    uint32_t location = 0;
+    uint32_t components = 0;
+    bool integer = false;
+  };
+
+  VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+  std::vector<Binding> bindings;
+  uint32_t pushConstantSize = 0; // 0 when the stage has no push block
+  std::vector<Input> inputs;     // vertex stage only
+};
+
+namespace reflection {
+
+// throws on anything that is not valid SPIR-V with a single entry point
+ShaderReflection reflect(const ShaderCode &code);
+
+// The attributes the vertex shader reads, picked from the caller's vertex
+// layouts: formats come from the CPU side structs, which the shader cannot
+// know about. When two bindings offer the same location the later one wins,
+// so per-instance data can sit on top of the shared quad's vertices. Throws
+// when the shader reads a location nobody provides or the numeric types
+// differ.
+std::vector<VkVertexInputAttributeDescription> selectAttributes(
+    const ShaderReflection &vertex,
+    const std::vector<VkVertexInputAttributeDescription> &available);
+
+}; // namespace reflection
+
+// Descriptor set and pipeline layouts derived from shader reflection. Stages
+// that use the same set/binding have their stage flags merged, and identical
+// set layouts and pipeline layouts are created once and shared, so
+// descriptor sets stay compatible across pipelines.
+//
+// Arrays of descriptors are bindless slots: they get PARTIALLY_BOUND and
+// UPDATE_UNUSED_WHILE_PENDING, which the device must have enabled.
+class LayoutCache {
+public:
+  struct PipelineLayout {
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSetLayout> setLayouts; // indexed by set number
+    VkPushConstantRange pushConstants{};           // size 0 when unused
+  };
+
+  void init(VkDevice device) { _device = device; }
+  void destroy();
+
+  // reflection results are cached per shader
+  const ShaderReflection &reflect(const ShaderCode &code);
+  const PipelineLayout &get(std::initializer_list<ShaderCode> stages);
+
+private:
+  VkDescriptorSetLayout
+  setLayout(const std::vector<VkDescriptorSetLayoutBinding> &bindings);
+
+  VkDevice _device = VK_NULL_HANDLE;
+  std::unordered_map<const uint32_t *, ShaderReflection> _reflections;
+  // keyed by the flattened bindings / set layout handles plus push range
+  std::map<std::vector<uint64_t>, VkDescriptorSetLayout> _setLayouts;
+  std::map<std::vector<uint64_t>, PipelineLayout> _pipelineLayouts;
+};
@@ -0,0 +1,64 @@
+#include "./spriteBatch.hpp"
+#include <cstddef>
+
+VkVertexInputBindingDescription SpriteInstance::getBindingDescription() {
+
+  VkVertexInputBindingDescription bindingDescription{};
+  bindingDescription.binding = 1;
+  bindingDescription.stride = sizeof(SpriteInstance);
+  bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 5>
+SpriteInstance::getAttributeDescriptions() {
+
+  std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions{};
+  // the mat3x2 takes one location per column
+  for (uint32_t column = 0; column < 3; column++) {
+    attributeDescriptions[column].binding = 1;
+    attributeDescriptions[column].location = 1 + column;
+    attributeDescriptions[column].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[column].offset =
+        offsetof(SpriteInstance, transform) + column * sizeof(glm::vec2);
+  }
+
+  attributeDescriptions[3].binding = 1;
+  attributeDescriptions[3].location = 4;
+  attributeDescriptions[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  attributeDescriptions[3].offset = offsetof(SpriteInstance, uvRect);
+
+  attributeDescriptions[4].binding = 1;
+  attributeDescriptions[4].location = 5;
+  attributeDescriptions[4].format = VK_FORMAT_R8G8B8A8_UNORM;
+  attributeDescriptions[4].offset = offsetof(SpriteInstance, tint);
+
+  return attributeDescriptions;
+}
+
+void SpriteBatch::build(SpriteInstance *dst, uint32_t textureCount) {
+  _groups.clear();
+  _offsets.assign(textureCount + 1, 0);
+  _unsortedRuns = 0;
+
+  for (uint32_t i = 0; i < _sprites.size(); i++) {
+    _offsets[_sprites[i].textureId + 1]++;
+    if (i == 0 || _sprites[i].textureId != _sprites[i - 1].textureId) {
+      _unsortedRuns++;
+    }
+  }
+
+  for (uint32_t i = 0; i < textureCount; i++) {
+    uint32_t count = _offsets[i + 1];
+    _offsets[i + 1] += _offsets[i];
+    if (count > 0) {
+      _groups.push_back({i, _offsets[i], count});
+    }
+  }
+
+  // _offsets[id] now points at the next free slot of each group
+  for (const auto &sprite : _sprites) {
+    dst[_offsets[sprite.textureId]++] = sprite;
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+// Per-instance data for the shared unit quad, vertex binding 1 of the sprite
+// pipeline.
+struct SpriteInstance {
+  glm::mat3x2 transform; // 2D affine: x axis, y axis, translation
+  glm::vec4 uvRect;      // u0, v0, u1, v1 with v0 at the top of the image
+  uint32_t tint;         // RGBA8, packed with packTint
+  uint32_t textureId;
+
+  static VkVertexInputBindingDescription getBindingDescription();
+
+  static std::array<VkVertexInputAttributeDescription, 5>
+  getAttributeDescriptions();
+};
+
+inline uint32_t packTint(glm::vec4 color) {
+  glm::vec4 clamped = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+  return static_cast<uint32_t>(clamped.x) |
+         static_cast<uint32_t>(clamped.y) << 8 |
+         static_cast<uint32_t>(clamped.z) << 16 |
+         static_cast<uint32_t>(clamped.w) << 24;
+}
+
+// One instanced draw: a run of instances sharing a texture.
+struct SpriteDrawGroup {
+  uint32_t textureId;
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+};
+
+// Collects sprites for a frame and writes them grouped by texture into a
+// mapped instance buffer.
+class SpriteBatch {
+public:
+  void clear() { _sprites.clear(); }
+  void add(const SpriteInstance &sprite) { _sprites.push_back(sprite); }
+  uint32_t size() const { return static_cast<uint32_t>(_sprites.size()); }
+
+  // counting sort by textureId straight into dst, which must hold size()
+  // instances; textureIds must be below textureCount
+  void build(SpriteInstance *dst, uint32_t textureCount);
+
+  const std::vector<SpriteDrawGroup> &groups() const { return _groups; }
+  // texture changes in the order the sprites were added, the draws and
+  // texture binds the batch would take unsorted
+  uint32_t unsortedRuns() const { return _unsortedRuns; }
+
+private:
+  std::vector<SpriteInstance> _sprites;
+  uint32_t _unsortedRuns = 0;
+  std::vector<uint32_t> _offsets;
+  std::vector<SpriteDrawGroup> _groups;
+};
@@ -0,0 +1,215 @@
+#include "./textureFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+texfile::MappedFile::~MappedFile() { close(); }
+
+texfile::MappedFile::MappedFile(MappedFile &&other) noexcept
+    : _data(other._data), _size(other._size) {
+  other._data = nullptr;
+  other._size = 0;
+}
+
+texfile::MappedFile &
+texfile::MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    _data = other._data;
+    _size = other._size;
+    other._data = nullptr;
+    other._size = 0;
+  }
+  return *this;
+}
+
+bool texfile::MappedFile::open(const std::string &path, bool sequential) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat fileStat{};
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *mapped = mmap(nullptr, static_cast<size_t>(fileStat.st_size),
+                      PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+
+  madvise(mapped, static_cast<size_t>(fileStat.st_size),
+          sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+  _data = static_cast<const uint8_t *>(mapped);
+  _size = static_cast<size_t>(fileStat.st_size);
+  return true;
+}
+
+void texfile::MappedFile::close() {
+  if (_data != nullptr) {
+    munmap(const_cast<uint8_t *>(_data), _size);
+    _data = nullptr;
+    _size = 0;
+  }
+}
+
+bool texfile::parse(const MappedFile &file, TextureView &view) {
+  if (file.data() == nullptr || file.size() < sizeof(Header)) {
+    return false;
+  }
+
+  const Header *header = reinterpret_cast<const Header *>(file.data());
+  VkFormat format = static_cast<VkFormat>(header->format);
+  if (header->magic != fileMagic || header->version != fileVersion ||
+      header->width == 0 || header->height == 0 || header->mipLevels == 0 ||
+      !isSupportedFormat(format)) {
+    return false;
+  }
+
+  // the chain ends at 1x1: floor(log2(max(width, height))) + 1 levels
+  uint32_t fullChain = 1;
+  for (uint32_t size = std::max(header->width, header->height); size > 1;
+       size >>= 1) {
+    fullChain++;
+  }
+  if (header->mipLevels > fullChain) {
+    return false;
+  }
+
+  // every check is written as a subtraction from a bound already known to
+  // hold, so a crafted offset or size cannot wrap past it
+  uint64_t tableEnd =
+      sizeof(Header) + uint64_t(header->mipLevels) * sizeof(MipLevel);
+  if (tableEnd > file.size() || header->payloadOffset < tableEnd ||
+      header->payloadOffset > file.size() ||
+      header->payloadSize > file.size() - header->payloadOffset) {
+    return false;
+  }
+
+  // the sizes are what gets uploaded, so they must be exactly what the
+  // format and mip dimensions call for; offsets become bufferOffset, which
+  // Vulkan wants a multiple of 4 and of the texel block size
+  uint64_t offsetAlignment = std::max<uint64_t>(4, blockBytes(format));
+  const MipLevel *levels =
+      reinterpret_cast<const MipLevel *>(file.data() + sizeof(Header));
+  for (uint32_t i = 0; i < header->mipLevels; i++) {
+    uint32_t width = std::max(1u, header->width >> i);
+    uint32_t height = std::max(1u, header->height >> i);
+    if (levels[i].width != width || levels[i].height != height ||
+        levels[i].size != levelSize(format, width, height) ||
+        levels[i].offset % offsetAlignment != 0 ||
+        levels[i].offset > header->payloadSize ||
+        levels[i].size > header->payloadSize - levels[i].offset) {
+      return false;
+    }
+  }
+
+  view.header = header;
+  view.levels = levels;
+  view.payload = file.data() + header->payloadOffset;
+  return true;
+}
+
+bool texfile::write(const std::string &path, VkFormat format, uint32_t width,
+                    uint32_t height,
+                    const std::vector<std::vector<uint8_t>> &levels) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  Header header{};
+  header.magic = fileMagic;
+  header.version = fileVersion;
+  header.format = static_cast<uint32_t>(format);
+  header.width = width;
+  header.height = height;
+  header.mipLevels = static_cast<uint32_t>(levels.size());
+
+  uint64_t tableEnd = sizeof(Header) + levels.size() * sizeof(MipLevel);
+  header.payloadOffset =
+      (tableEnd + levelAlignment - 1) & ~(levelAlignment - 1);
+
+  std::vector<MipLevel> table(levels.size());
+  uint64_t offset = 0;
+  for (size_t i = 0; i < levels.size(); i++) {
+    table[i].offset = offset;
+    table[i].size = levels[i].size();
+    table[i].width = std::max(1u, width >> i);
+    table[i].height = std::max(1u, height >> i);
+    offset += levels[i].size();
+    offset = (offset + levelAlignment - 1) & ~(levelAlignment - 1);
+  }
+  header.payloadSize = offset;
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(table.data()),
+             table.size() * sizeof(MipLevel));
+
+  std::vector<char> padding(levelAlignment, 0);
+  file.write(padding.data(), header.payloadOffset - tableEnd);
+
+  for (size_t i = 0; i < levels.size(); i++) {
+    file.write(reinterpret_cast<const char *>(levels[i].data()),
+               levels[i].size());
+    uint64_t end = table[i].offset + table[i].size;
+    uint64_t next = i + 1 < levels.size() ? table[i + 1].offset : offset;
+    file.write(padding.data(), next - end);
+  }
+
+  return file.good();
+}
+
+bool texfile::isBlockCompressed(VkFormat format) {
+  return format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+         format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK ||
+         format == VK_FORMAT_BC3_SRGB_BLOCK ||
+         format == VK_FORMAT_BC3_UNORM_BLOCK;
+}
+
+bool texfile::isSupportedFormat(VkFormat format) {
+  return format == VK_FORMAT_R8G8B8A8_SRGB ||
+         format == VK_FORMAT_R8G8B8A8_UNORM || isBlockCompressed(format);
+}
+
+uint64_t texfile::blockBytes(VkFormat format) {
+  if (!isBlockCompressed(format)) {
+    return 4;
+  }
+  bool bc1 = format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+             format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  return bc1 ? 8 : 16;
+}
+
+uint64_t texfile::levelSize(VkFormat format, uint32_t width, uint32_t height) {
+  if (!isBlockCompressed(format)) {
+    return static_cast<uint64_t>(width) * height * blockBytes(format);
+  }
+
+  uint64_t blocks =
+      static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4);
+  return blocks * blockBytes(format);
+}
+
+std::string texfile::cookedPath(const std::string &sourcePath) {
+  size_t slash = sourcePath.find_last_of('/');
+  std::string name =
+      slash == std::string::npos ? sourcePath : sourcePath.substr(slash + 1);
+  size_t dot = name.find_last_of('.');
+  if (dot != std::string::npos) {
+    name = name.substr(0, dot);
+  }
+  return std::string(cookedDirectory) + "/" + name + ".vtex";
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+// Cooked texture container (.vtex). Produced offline by TextureCooker, the
+// payload already holds every mip level in the final VkFormat so the runtime
+// only has to copy it into a staging buffer.
+//
+// layout: Header | MipLevel[mipLevels] | payload (levels 16-byte aligned)
+namespace texfile {
+
+constexpr uint32_t fileMagic = 0x58455456; // "VTEX"
+constexpr uint32_t fileVersion = 1;
+constexpr uint64_t levelAlignment = 16;
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format; // VkFormat
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipLevels;
+  uint64_t payloadOffset;
+  uint64_t payloadSize;
+};
+
+struct MipLevel {
+  uint64_t offset; // relative to payloadOffset
+  uint64_t size;
+  uint32_t width;
+  uint32_t height;
+};
+
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  // sequential for files read front to back once, otherwise the kernel is
+  // told not to read ahead
+  bool open(const std::string &path, bool sequential = true);
+  void close();
+
+  const uint8_t *data() const { return _data; }
+  size_t size() const { return _size; }
+
+private:
+  const uint8_t *_data = nullptr;
+  size_t _size = 0;
+};
+
+struct TextureView {
+  const Header *header = nullptr;
+  const MipLevel *levels = nullptr;
+  const uint8_t *payload = nullptr;
+};
+
+// validates the header and level table against the mapped size and the
+// level sizes against the format and mip dimensions
+bool parse(const MappedFile &file, TextureView &view);
+
+bool write(const std::string &path, VkFormat format, uint32_t width,
+           uint32_t height, const std::vector<std::vector<uint8_t>> &levels);
+
+bool isBlockCompressed(VkFormat format);
+// RGBA8 or one of the BC formats above, what levelSize knows how to size
+bool isSupportedFormat(VkFormat format);
+// bytes per texel for RGBA8, per 4x4 block for BC
+uint64_t blockBytes(VkFormat format);
+uint64_t levelSize(VkFormat format, uint32_t width, uint32_t height);
+
+// cook_textures writes into the build tree, which is also the working
+// directory the engine runs from, so the source tree stays clean
+constexpr const char *cookedDirectory = "textures";
+
+// "../textures/grass.jpg" -> "textures/grass.vtex"
+std::string cookedPath(const std::string &sourcePath);
+
+}; // namespace texfile
@@ -0,0 +1,65 @@
+#include "./threadPool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+  if (threadCount == 0) {
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    threadCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+  }
+
+  _workers.reserve(threadCount);
+  for (unsigned i = 0; i < threadCount; i++) {
+    _workers.emplace_back([this] { workerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _jobAvailable.notify_all();
+
+  for (auto &worker : _workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _jobs.push_back(std::move(job));
+  }
+  _jobAvailable.notify_one();
+}
+
+void ThreadPool::waitIdle() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _idle.wait(lock, [this] { return _jobs.empty() && _activeJobs == 0; });
+}
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _jobAvailable.wait(lock, [this] { return _stopping || !_jobs.empty(); });
+      if (_stopping && _jobs.empty()) {
+        return;
+      }
+      job = std::move(_jobs.front());
+      _jobs.pop_front();
+      _activeJobs++;
+    }
+
+    job();
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _activeJobs--;
+      if (_jobs.empty() && _activeJobs == 0) {
+        _idle.notify_all();
+      }
+    }
+  }
+}
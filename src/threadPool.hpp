@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+  // 0 picks one worker per hardware thread, leaving the render thread free
+  explicit ThreadPool(unsigned threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  void submit(std::function<void()> job);
+  void waitIdle();
+  unsigned size() const { return static_cast<unsigned>(_workers.size()); }
+
+private:
+  void workerLoop();
+
+  std::vector<std::thread> _workers;
+  std::deque<std::function<void()>> _jobs;
+  std::mutex _mutex;
+  std::condition_variable _jobAvailable;
+  std::condition_variable _idle;
+  size_t _activeJobs = 0;
+  bool _stopping = false;
+};
+
+// Multi-producer queue the workers push results into and the render thread
+// drains.
+template <typename T> class CompletionQueue {
+public:
+  void push(T &&item) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _items.push_back(std::move(item));
+    }
+    _available.notify_one();
+  }
+
+  bool tryPop(T &item) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_items.empty()) {
+      return false;
+    }
+    item = std::move(_items.front());
+    _items.pop_front();
+    return true;
+  }
+
+  T waitPop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _available.wait(lock, [this] { return !_items.empty(); });
+    T item = std::move(_items.front());
+    _items.pop_front();
+    return item;
+  }
+
+private:
+  std::deque<T> _items;
+  std::mutex _mutex;
+  std::condition_variable _available;
+};
@@ -0,0 +1,179 @@
+#include "./tilemap.hpp"
+#include <algorithm>
+
+Tilemap::Tilemap(int width, int height)
+    : _width(std::max(width, 0)), _height(std::max(height, 0)),
+      _tiles(static_cast<size_t>(_width) * _height, Tile{0}),
+      _chunkDirty(static_cast<size_t>(chunksX()) * chunksY()) {}
+
+void Tilemap::fill(uint16_t type) {
+  std::fill(_tiles.begin(), _tiles.end(), Tile{type});
+  markDirty(0, 0, _width, _height);
+}
+
+void Tilemap::fillRect(int x, int y, int w, int h, uint16_t type) {
+  int x0 = std::max(x, 0), x1 = std::min(x + w, _width);
+  int y0 = std::max(y, 0), y1 = std::min(y + h, _height);
+  for (int row = y0; row < y1 && x0 < x1; row++) {
+    std::fill_n(_tiles.data() + index(x0, row), x1 - x0, Tile{type});
+  }
+  markDirty(x, y, w, h);
+}
+
+void Tilemap::readRect(int x, int y, int w, int h, Tile *out) const {
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+  std::fill_n(out, static_cast<size_t>(w) * h, Tile{0});
+  int x0 = std::max(x, 0), x1 = std::min(x + w, _width);
+  int y0 = std::max(y, 0), y1 = std::min(y + h, _height);
+  for (int row = y0; row < y1 && x0 < x1; row++) {
+    std::copy_n(_tiles.data() + index(x0, row), x1 - x0,
+                out + static_cast<size_t>(row - y) * w + (x0 - x));
+  }
+}
+
+void Tilemap::writeRect(int x, int y, int w, int h, const Tile *in) {
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+  int x0 = std::max(x, 0), x1 = std::min(x + w, _width);
+  int y0 = std::max(y, 0), y1 = std::min(y + h, _height);
+  for (int row = y0; row < y1 && x0 < x1; row++) {
+    std::copy_n(in + static_cast<size_t>(row - y) * w + (x0 - x), x1 - x0,
+                _tiles.data() + index(x0, row));
+  }
+  markDirty(x, y, w, h);
+}
+
+void Tilemap::markDirty(int x, int y, int w, int h, bool shapeChanged) {
+  int x0 = std::max(x, 0), x1 = std::min(x + w, _width);
+  int y0 = std::max(y, 0), y1 = std::min(y + h, _height);
+  if (x0 >= x1 || y0 >= y1) {
+    return;
+  }
+
+  for (int chunkY = y0 / chunkSize; chunkY <= (y1 - 1) / chunkSize;
+       chunkY++) {
+    int originY = chunkY * chunkSize;
+    uint8_t top = static_cast<uint8_t>(std::max(y0 - originY, 0));
+    uint8_t bottom = static_cast<uint8_t>(std::min(y1 - originY, chunkSize));
+    for (int chunkX = x0 / chunkSize; chunkX <= (x1 - 1) / chunkSize;
+         chunkX++) {
+      int originX = chunkX * chunkSize;
+      uint8_t left = static_cast<uint8_t>(std::max(x0 - originX, 0));
+      uint8_t right = static_cast<uint8_t>(std::min(x1 - originX, chunkSize));
+
+      uint32_t chunk = static_cast<uint32_t>(chunkY * chunksX() + chunkX);
+      ChunkDirty &dirty = _chunkDirty[chunk];
+      if (dirty.x1 == 0) {
+        dirty = {left, top, right, bottom, shapeChanged};
+        _dirtyChunks.push_back(chunk);
+      } else {
+        dirty.x0 = std::min(dirty.x0, left);
+        dirty.y0 = std::min(dirty.y0, top);
+        dirty.x1 = std::max(dirty.x1, right);
+        dirty.y1 = std::max(dirty.y1, bottom);
+        dirty.shapeChanged = dirty.shapeChanged || shapeChanged;
+      }
+    }
+  }
+}
+
+void Tilemap::takeDirty(std::vector<DirtyRegion> &out, size_t maxRegions) {
+  size_t count = std::min(maxRegions, _dirtyChunks.size());
+  for (size_t i = 0; i < count; i++) {
+    uint32_t chunk = _dirtyChunks[i];
+    ChunkDirty &dirty = _chunkDirty[chunk];
+    int originX = static_cast<int>(chunk % chunksX()) * chunkSize;
+    int originY = static_cast<int>(chunk / chunksX()) * chunkSize;
+    out.push_back({static_cast<int>(chunk), originX + dirty.x0,
+                   originY + dirty.y0, dirty.x1 - dirty.x0,
+                   dirty.y1 - dirty.y0, dirty.shapeChanged});
+    dirty = {};
+  }
+  _dirtyChunks.erase(_dirtyChunks.begin(), _dirtyChunks.begin() + count);
+}
+
+void Tilemap::clearDirty() {
+  for (uint32_t chunk : _dirtyChunks) {
+    _chunkDirty[chunk] = {};
+  }
+  _dirtyChunks.clear();
+}
+
+void Tilemap::copyRect(const Tilemap &source, int sourceX, int sourceY, int w,
+                       int h, int x, int y) {
+  if (w <= 0 || h <= 0) {
+    return;
+  }
+  std::vector<Tile> region(static_cast<size_t>(w) * h);
+  source.readRect(sourceX, sourceY, w, h, region.data());
+  writeRect(x, y, w, h, region.data());
+}
+
+void tilemapMesh::buildChunk(const Tilemap &tilemap, int chunkX, int chunkY,
+                             uint32_t atlasColumns, uint32_t atlasRows,
+                             std::vector<vertexData::Vertex> &vertices,
+                             std::vector<uint32_t> &indices) {
+  const float tileSize = 1.0f;
+  const glm::vec3 tileColor(1.0f, 1.0f, 1.0f);
+
+  // clipped once here, the rows are then walked unchecked
+  int startX = chunkX * Tilemap::chunkSize;
+  int startY = chunkY * Tilemap::chunkSize;
+  int columns = std::min(Tilemap::chunkSize, tilemap.width() - startX);
+  int rows = std::min(Tilemap::chunkSize, tilemap.height() - startY);
+
+  for (int y = 0; y < rows; y++) {
+    const Tile *row = tilemap.row(startY + y) + startX;
+    for (int x = 0; x < columns; x++) {
+      Tile tile = row[x];
+      if (tile.type == 0)
+        continue;
+
+      float u1 = (float)((tile.type - 1) % atlasColumns) / atlasColumns;
+      float v1 = (float)((tile.type - 1) / atlasColumns) / atlasRows;
+      float u2 = u1 + 1.0f / atlasColumns;
+      float v2 = v1 + 1.0f / atlasRows;
+
+      float left = x * tileSize - 0.5f;
+      float bottom = y * tileSize - 0.5f;
+      glm::vec2 pos1(left, bottom);
+      glm::vec2 pos2(left + tileSize, bottom);
+      glm::vec2 pos3(left + tileSize, bottom + tileSize);
+      glm::vec2 pos4(left, bottom + tileSize);
+
+      uint32_t baseIndex = static_cast<uint32_t>(vertices.size());
+
+      vertices.push_back({pos1, tileColor, {u1, v1}});
+      vertices.push_back({pos2, tileColor, {u2, v1}});
+      vertices.push_back({pos3, tileColor, {u2, v2}});
+      vertices.push_back({pos4, tileColor, {u1, v2}});
+
+      indices.push_back(baseIndex);
+      indices.push_back(baseIndex + 1);
+      indices.push_back(baseIndex + 2);
+      indices.push_back(baseIndex);
+      indices.push_back(baseIndex + 2);
+      indices.push_back(baseIndex + 3);
+    }
+  }
+}
+
+int tilemapMesh::quadsBefore(const Tilemap &tilemap, int chunkX, int chunkY,
+                             int x, int y) {
+  int startX = chunkX * Tilemap::chunkSize;
+  int startY = chunkY * Tilemap::chunkSize;
+  int columns = std::min(Tilemap::chunkSize, tilemap.width() - startX);
+
+  int quads = 0;
+  for (int row = startY; row <= y; row++) {
+    const Tile *tiles = tilemap.row(row) + startX;
+    int end = row < y ? columns : x - startX;
+    for (int column = 0; column < end; column++) {
+      quads += tiles[column].type != 0 ? 1 : 0;
+    }
+  }
+  return quads;
+}
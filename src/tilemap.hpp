@@ -0,0 +1,125 @@
+#pragma once
+
+#include "./vertexData.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Tile {
+  uint16_t type; // 0 is empty, n is atlas cell n - 1
+};
+
+// Tile grid in one row-major allocation. Rows are contiguous, so a row or
+// part of one is a plain span, and bulk operations work a row at a time.
+// chunkSize is the unit the renderer builds and streams the map in.
+//
+// Edits through setTile and the bulk operations are recorded per chunk as
+// the rectangle of tiles touched, so the renderer uploads only those. at()
+// and row() bypass the tracking; call markDirty after writing through them.
+class Tilemap {
+public:
+  static constexpr int chunkSize = 32;
+
+  // map coordinates, always inside one chunk
+  struct DirtyRegion {
+    int chunk; // chunkY * chunksX() + chunkX
+    int x, y, w, h;
+    // some tile went from empty to non-empty or back, which moves the
+    // tiles after it in a chunk mesh
+    bool shapeChanged;
+  };
+
+  Tilemap() = default;
+  Tilemap(int width, int height);
+
+  int width() const { return _width; }
+  int height() const { return _height; }
+  int chunksX() const { return (_width + chunkSize - 1) / chunkSize; }
+  int chunksY() const { return (_height + chunkSize - 1) / chunkSize; }
+  bool contains(int x, int y) const {
+    return x >= 0 && x < _width && y >= 0 && y < _height;
+  }
+
+  // reads outside the map are empty tiles, writes outside are dropped
+  Tile getTile(int x, int y) const {
+    return contains(x, y) ? _tiles[index(x, y)] : Tile{0};
+  }
+  void setTile(int x, int y, uint16_t type) {
+    if (!contains(x, y)) {
+      return;
+    }
+    Tile &tile = _tiles[index(x, y)];
+    if (tile.type != type) {
+      markDirty(x, y, 1, 1, (tile.type == 0) != (type == 0));
+      tile.type = type;
+    }
+  }
+
+  // unchecked, x and y must be inside the map
+  size_t index(int x, int y) const {
+    return static_cast<size_t>(y) * _width + x;
+  }
+  Tile &at(int x, int y) { return _tiles[index(x, y)]; }
+  const Tile &at(int x, int y) const { return _tiles[index(x, y)]; }
+  // width() tiles
+  Tile *row(int y) { return _tiles.data() + index(0, y); }
+  const Tile *row(int y) const { return _tiles.data() + index(0, y); }
+  const Tile *data() const { return _tiles.data(); }
+
+  // bulk operations, clipped to the map
+  void fill(uint16_t type);
+  void fillRect(int x, int y, int w, int h, uint16_t type);
+  // row-major w x h tiles; the parts outside the map read as empty tiles or
+  // are skipped when writing
+  void readRect(int x, int y, int w, int h, Tile *out) const;
+  void writeRect(int x, int y, int w, int h, const Tile *in);
+  // through a temporary, so source and destination may be the same map
+  void copyRect(const Tilemap &source, int sourceX, int sourceY, int w, int h,
+                int x, int y);
+
+  // clipped to the map; grows the chunks' pending rectangles
+  void markDirty(int x, int y, int w, int h, bool shapeChanged = true);
+  size_t dirtyCount() const { return _dirtyChunks.size(); }
+  // moves up to maxRegions pending regions, oldest first, into out
+  void takeDirty(std::vector<DirtyRegion> &out, size_t maxRegions = SIZE_MAX);
+  void clearDirty();
+
+private:
+  // chunk-local, empty while x1 == 0
+  struct ChunkDirty {
+    uint8_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    bool shapeChanged = false;
+  };
+
+  int _width = 0;
+  int _height = 0;
+  std::vector<Tile> _tiles;
+  std::vector<ChunkDirty> _chunkDirty;
+  std::vector<uint32_t> _dirtyChunks; // in the order they were first dirtied
+};
+
+// matches the push_constant block in tilemap.vert/.frag
+struct TilemapPushConstants {
+  glm::vec4 rect; // world space min.xy, max.xy of the quad
+  uint32_t atlasColumns;
+  uint32_t atlasRows;
+  float depth; // gl_Position.z, see layerDepth
+};
+static_assert(sizeof(TilemapPushConstants) == 28,
+              "push constant layout must match tilemap.vert");
+
+namespace tilemapMesh {
+
+// Four vertices and six indices per non-empty tile of the chunk, positions
+// relative to the chunk's first tile and uv picked from a columns x rows
+// atlas. Appends to vertices and indices.
+void buildChunk(const Tilemap &tilemap, int chunkX, int chunkY,
+                uint32_t atlasColumns, uint32_t atlasRows,
+                std::vector<vertexData::Vertex> &vertices,
+                std::vector<uint32_t> &indices);
+
+// Quads buildChunk emits for the chunk's tiles before map tile (x, y), which
+// must lie inside the chunk; the tile's first vertex is 4 times that.
+int quadsBefore(const Tilemap &tilemap, int chunkX, int chunkY, int x, int y);
+
+}; // namespace tilemapMesh
@@ -0,0 +1,163 @@
+#include "./transformKernels.hpp"
+#include <cmath>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TRANSFORM_KERNELS_X86 1
+#endif
+
+void TransformSoA::resize(size_t count) {
+  for (auto *array : {&x, &y, &vx, &vy, &rot, &sx, &sy, &m00, &m10, &m01,
+                      &m11}) {
+    array->resize(count, 0.0f);
+  }
+}
+
+void TransformSoA::swap(size_t a, size_t b) {
+  for (auto *array : {&x, &y, &vx, &vy, &rot, &sx, &sy, &m00, &m10, &m01,
+                      &m11}) {
+    std::swap((*array)[a], (*array)[b]);
+  }
+}
+
+bool transformKernels::hasAvx2() {
+#ifdef TRANSFORM_KERNELS_X86
+  static const bool supported =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+void transformKernels::integrate(TransformSoA &soa, size_t begin, size_t end,
+                                 float deltaTime) {
+  if (hasAvx2()) {
+    integrateAvx2(soa, begin, end, deltaTime);
+  } else {
+    integrateScalar(soa, begin, end, deltaTime);
+  }
+}
+
+void transformKernels::buildAffine(TransformSoA &soa, size_t begin,
+                                   size_t end) {
+  if (hasAvx2()) {
+    buildAffineAvx2(soa, begin, end);
+  } else {
+    buildAffineScalar(soa, begin, end);
+  }
+}
+
+void transformKernels::integrateScalar(TransformSoA &soa, size_t begin,
+                                       size_t end, float deltaTime) {
+  for (size_t i = begin; i < end; i++) {
+    soa.x[i] += soa.vx[i] * deltaTime;
+    soa.y[i] += soa.vy[i] * deltaTime;
+  }
+}
+
+void transformKernels::buildAffineScalar(TransformSoA &soa, size_t begin,
+                                         size_t end) {
+  for (size_t i = begin; i < end; i++) {
+    float s = std::sin(soa.rot[i]);
+    float c = std::cos(soa.rot[i]);
+    soa.m00[i] = c * soa.sx[i];
+    soa.m10[i] = s * soa.sx[i];
+    soa.m01[i] = -s * soa.sy[i];
+    soa.m11[i] = c * soa.sy[i];
+  }
+}
+
+#ifdef TRANSFORM_KERNELS_X86
+
+// sin and cos of 8 angles: reduce by multiples of pi/2 (Cody-Waite, three
+// parts), evaluate the cephes minimax polynomials on [-pi/4, pi/4] and fix
+// up by quadrant. Around 1e-7 absolute error for the angles sprites use.
+__attribute__((target("avx2,fma"))) static void sinCos8(__m256 angle,
+                                                        __m256 &sinOut,
+                                                        __m256 &cosOut) {
+  __m256 q = _mm256_round_ps(
+      _mm256_mul_ps(angle, _mm256_set1_ps(0.63661977236758134f)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(1.5703125f), angle);
+  r = _mm256_fnmadd_ps(q, _mm256_set1_ps(4.837512969970703125e-4f), r);
+  r = _mm256_fnmadd_ps(q, _mm256_set1_ps(7.54978995489188216e-8f), r);
+  __m256i quadrant = _mm256_cvtps_epi32(q);
+
+  __m256 r2 = _mm256_mul_ps(r, r);
+
+  __m256 sinPoly = _mm256_fmadd_ps(_mm256_set1_ps(-1.9515295891e-4f), r2,
+                                   _mm256_set1_ps(8.3321608736e-3f));
+  sinPoly = _mm256_fmadd_ps(sinPoly, r2, _mm256_set1_ps(-1.6666654611e-1f));
+  sinPoly = _mm256_fmadd_ps(_mm256_mul_ps(sinPoly, r2), r, r);
+
+  __m256 cosPoly = _mm256_fmadd_ps(_mm256_set1_ps(2.443315711809948e-5f), r2,
+                                   _mm256_set1_ps(-1.388731625493765e-3f));
+  cosPoly = _mm256_fmadd_ps(cosPoly, r2, _mm256_set1_ps(4.166664568298827e-2f));
+  cosPoly = _mm256_fmadd_ps(
+      cosPoly, _mm256_mul_ps(r2, r2),
+      _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), r2, _mm256_set1_ps(1.0f)));
+
+  // odd quadrants swap sin and cos, the sign comes from bit 1
+  __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+      _mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+  __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30));
+  __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_and_si256(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)),
+                       _mm256_set1_epi32(2)),
+      30));
+
+  sinOut = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, swap), sinSign);
+  cosOut = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, swap), cosSign);
+}
+
+__attribute__((target("avx2,fma"))) void
+transformKernels::integrateAvx2(TransformSoA &soa, size_t begin, size_t end,
+                                float deltaTime) {
+  __m256 dt = _mm256_set1_ps(deltaTime);
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 x = _mm256_loadu_ps(&soa.x[i]);
+    __m256 y = _mm256_loadu_ps(&soa.y[i]);
+    x = _mm256_fmadd_ps(_mm256_loadu_ps(&soa.vx[i]), dt, x);
+    y = _mm256_fmadd_ps(_mm256_loadu_ps(&soa.vy[i]), dt, y);
+    _mm256_storeu_ps(&soa.x[i], x);
+    _mm256_storeu_ps(&soa.y[i], y);
+  }
+  integrateScalar(soa, i, end, deltaTime);
+}
+
+__attribute__((target("avx2,fma"))) void
+transformKernels::buildAffineAvx2(TransformSoA &soa, size_t begin,
+                                  size_t end) {
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 s, c;
+    sinCos8(_mm256_loadu_ps(&soa.rot[i]), s, c);
+    __m256 sx = _mm256_loadu_ps(&soa.sx[i]);
+    __m256 sy = _mm256_loadu_ps(&soa.sy[i]);
+    _mm256_storeu_ps(&soa.m00[i], _mm256_mul_ps(c, sx));
+    _mm256_storeu_ps(&soa.m10[i], _mm256_mul_ps(s, sx));
+    _mm256_storeu_ps(&soa.m01[i],
+                     _mm256_mul_ps(_mm256_xor_ps(s, _mm256_set1_ps(-0.0f)),
+                                   sy));
+    _mm256_storeu_ps(&soa.m11[i], _mm256_mul_ps(c, sy));
+  }
+  buildAffineScalar(soa, i, end);
+}
+
+#else
+
+void transformKernels::integrateAvx2(TransformSoA &soa, size_t begin,
+                                     size_t end, float deltaTime) {
+  integrateScalar(soa, begin, end, deltaTime);
+}
+
+void transformKernels::buildAffineAvx2(TransformSoA &soa, size_t begin,
+                                       size_t end) {
+  buildAffineScalar(soa, begin, end);
+}
+
+#endif
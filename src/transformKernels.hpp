@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Structure-of-arrays simulation state, one slot per entity. The m* arrays
+// are kernel output: the 2D affine columns (m00, m10) and (m01, m11), with
+// the translation taken straight from (x, y).
+struct TransformSoA {
+  std::vector<float> x, y;
+  std::vector<float> vx, vy;
+  std::vector<float> rot;
+  std::vector<float> sx, sy;
+  std::vector<float> m00, m10, m01, m11;
+
+  size_t size() const { return x.size(); }
+  void resize(size_t count);
+  void swap(size_t a, size_t b);
+};
+
+// Batch kernels over slots [begin, end). The AVX2 versions process 8 slots
+// per iteration and finish the tail with the scalar code; the dispatching
+// entry points pick AVX2 when the CPU has it.
+namespace transformKernels {
+
+bool hasAvx2();
+
+void integrate(TransformSoA &soa, size_t begin, size_t end, float deltaTime);
+void buildAffine(TransformSoA &soa, size_t begin, size_t end);
+
+void integrateScalar(TransformSoA &soa, size_t begin, size_t end,
+                     float deltaTime);
+void buildAffineScalar(TransformSoA &soa, size_t begin, size_t end);
+
+void integrateAvx2(TransformSoA &soa, size_t begin, size_t end,
+                   float deltaTime);
+void buildAffineAvx2(TransformSoA &soa, size_t begin, size_t end);
+
+}; // namespace transformKernels
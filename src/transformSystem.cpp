@@ -0,0 +1,110 @@
+#include "./transformSystem.hpp"
+
+void TransformSystem::added(uint32_t mesh, glm::vec2 position) {
+  uint32_t slot = static_cast<uint32_t>(_state.size());
+  _state.resize(slot + 1);
+  _state.x[slot] = position.x;
+  _state.y[slot] = position.y;
+  _state.sx[slot] = 1.0f;
+  _state.sy[slot] = 1.0f;
+
+  if (_slotOfMesh.size() <= mesh) {
+    _slotOfMesh.resize(mesh + 1);
+    _dirtyFlags.resize(mesh + 1, 0);
+  }
+  _slotOfMesh[mesh] = slot;
+  _meshOfSlot.push_back(mesh);
+
+  markDirty(mesh);
+}
+
+void TransformSystem::setPosition(uint32_t mesh, glm::vec2 position) {
+  uint32_t slot = _slotOfMesh[mesh];
+  _state.x[slot] = position.x;
+  _state.y[slot] = position.y;
+  markDirty(mesh);
+}
+
+void TransformSystem::setRotation(uint32_t mesh, float rotation) {
+  _state.rot[_slotOfMesh[mesh]] = rotation;
+  markDirty(mesh);
+}
+
+void TransformSystem::setScale(uint32_t mesh, glm::vec2 scale) {
+  uint32_t slot = _slotOfMesh[mesh];
+  _state.sx[slot] = scale.x;
+  _state.sy[slot] = scale.y;
+  markDirty(mesh);
+}
+
+void TransformSystem::setVelocity(uint32_t mesh, glm::vec2 velocity) {
+  uint32_t slot = _slotOfMesh[mesh];
+  _state.vx[slot] = velocity.x;
+  _state.vy[slot] = velocity.y;
+
+  bool moving = velocity.x != 0.0f || velocity.y != 0.0f;
+  bool active = slot < _activeCount;
+  if (moving && !active) {
+    swapSlots(slot, _activeCount);
+    _activeCount++;
+  } else if (!moving && active) {
+    _activeCount--;
+    swapSlots(slot, _activeCount);
+  }
+}
+
+glm::vec2 TransformSystem::position(uint32_t mesh) const {
+  uint32_t slot = _slotOfMesh[mesh];
+  return glm::vec2(_state.x[slot], _state.y[slot]);
+}
+
+glm::vec2 TransformSystem::velocity(uint32_t mesh) const {
+  uint32_t slot = _slotOfMesh[mesh];
+  return glm::vec2(_state.vx[slot], _state.vy[slot]);
+}
+
+void TransformSystem::update(float deltaTime) {
+  _written.clear();
+  transformKernels::integrate(_state, 0, _activeCount, deltaTime);
+  transformKernels::buildAffine(_state, 0, _activeCount);
+  for (uint32_t slot = 0; slot < _activeCount; slot++) {
+    writeTransform(slot);
+  }
+
+  // edited static meshes, movers were rebuilt above
+  for (uint32_t mesh : _dirty) {
+    _dirtyFlags[mesh] = 0;
+    uint32_t slot = _slotOfMesh[mesh];
+    if (slot >= _activeCount) {
+      transformKernels::buildAffineScalar(_state, slot, slot + 1);
+      writeTransform(slot);
+    }
+  }
+  _dirty.clear();
+}
+
+void TransformSystem::markDirty(uint32_t mesh) {
+  if (!_dirtyFlags[mesh]) {
+    _dirtyFlags[mesh] = 1;
+    _dirty.push_back(mesh);
+  }
+}
+
+void TransformSystem::swapSlots(uint32_t a, uint32_t b) {
+  if (a == b) {
+    return;
+  }
+  _state.swap(a, b);
+  std::swap(_meshOfSlot[a], _meshOfSlot[b]);
+  _slotOfMesh[_meshOfSlot[a]] = a;
+  _slotOfMesh[_meshOfSlot[b]] = b;
+}
+
+void TransformSystem::writeTransform(uint32_t slot) {
+  _written.push_back(_meshOfSlot[slot]);
+  Mesh &mesh = _meshes[_meshOfSlot[slot]];
+  mesh.transform = glm::mat3x2(glm::vec2(_state.m00[slot], _state.m10[slot]),
+                               glm::vec2(_state.m01[slot], _state.m11[slot]),
+                               glm::vec2(_state.x[slot], _state.y[slot]));
+  mesh.updateBounds();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "./initMeshes.hpp"
+#include "./transformKernels.hpp"
+#include <cstdint>
+#include <vector>
+
+// Owns the simulation state of _meshes (position, velocity, rotation, scale)
+// in structure-of-arrays slots and writes Mesh::transform from it. Slots are
+// kept partitioned: meshes with a non-zero velocity occupy [0, activeCount)
+// so update() runs the batch kernels over one contiguous range of movers.
+// Static meshes are only rebuilt after a setter marks them dirty.
+class TransformSystem {
+public:
+  explicit TransformSystem(std::vector<Mesh> &meshes) : _meshes(meshes) {}
+
+  // call once the mesh is in the vector, its first transform is built on
+  // the next update
+  void added(uint32_t mesh, glm::vec2 position);
+
+  void setPosition(uint32_t mesh, glm::vec2 position);
+  void setRotation(uint32_t mesh, float rotation);
+  void setScale(uint32_t mesh, glm::vec2 scale);
+  void setVelocity(uint32_t mesh, glm::vec2 velocity);
+
+  glm::vec2 position(uint32_t mesh) const;
+  glm::vec2 velocity(uint32_t mesh) const;
+
+  void update(float deltaTime);
+
+  uint32_t activeCount() const { return _activeCount; }
+  uint32_t lastUpdated() const {
+    return static_cast<uint32_t>(_written.size());
+  }
+  // meshes whose transform the last update() wrote
+  const std::vector<uint32_t> &written() const { return _written; }
+
+private:
+  void markDirty(uint32_t mesh);
+  void swapSlots(uint32_t a, uint32_t b);
+  void writeTransform(uint32_t slot);
+
+  std::vector<Mesh> &_meshes;
+  TransformSoA _state;
+  std::vector<uint32_t> _slotOfMesh;
+  std::vector<uint32_t> _meshOfSlot;
+  uint32_t _activeCount = 0;
+
+  std::vector<uint8_t> _dirtyFlags; // per mesh
+  std::vector<uint32_t> _dirty;
+  std::vector<uint32_t> _written;
+};
@@ -10,16 +10,29 @@
 
 namespace vertexData {
 
+// 12 bytes per vertex, decoded by the vertex input formats:
+//   position  R16G16_SFLOAT   exact for multiples of 0.5 up to +-1024
+//   color     R8G8B8A8_UNORM
+//   texCoord  R16G16_UNORM
 struct Vertex {
-  glm::vec2 position;
-  glm::vec3 color;
-  glm::vec2 texCoord;
+  uint32_t position;
+  uint32_t color;
+  uint32_t texCoord;
+
+  Vertex() = default;
+  Vertex(glm::vec2 position, glm::vec3 color, glm::vec2 texCoord)
+      : position(glm::packHalf2x16(position)),
+        color(glm::packUnorm4x8(glm::vec4(color, 1.0f))),
+        texCoord(glm::packUnorm2x16(texCoord)) {}
+
+  glm::vec2 unpackPosition() const { return glm::unpackHalf2x16(position); }
 
   static VkVertexInputBindingDescription getBindingDescription();
 
   static std::array<VkVertexInputAttributeDescription, 3>
   getAttributeDescriptions();
 };
+static_assert(sizeof(Vertex) == 12, "compact vertex layout");
 
 const std::vector<Vertex> vertices = {
     {{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
@@ -27,6 +40,6 @@ const std::vector<Vertex> vertices = {
     {{0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
     {{-0.5f, 0.5f}, {1.0f, 1.0f, 1.0f}, {1.0f, 1.0f}}};
 
-const std::vector<uint16_t> indices = {0, 1, 2, 2, 3, 0};
+const std::vector<uint32_t> indices = {0, 1, 2, 2, 3, 0};
 
 }; // namespace vertexData
@@ -0,0 +1,203 @@
+// Saves and loads a map as .vmap and as a naive dump (width, height, then
+// every tile), comparing file size, save time, full load time and the time
+// to decode just the chunks of one screen, which is what the engine does at
+// startup.
+//
+//   MapFileBench [map size] [directory]      default: 4096 .
+
+#include "../src/mapFile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+// best of a few runs, the first one also pays for cold page cache and
+// page faults
+template <typename F> double milliseconds(F &&work) {
+  double best = 0.0;
+  for (int i = 0; i < 3; i++) {
+    auto start = Clock::now();
+    work();
+    double elapsed =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count();
+    best = i == 0 ? elapsed : std::min(best, elapsed);
+  }
+  return best;
+}
+
+bool writeDump(const std::string &path, const Tilemap &tilemap) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  int32_t size[2] = {tilemap.width(), tilemap.height()};
+  file.write(reinterpret_cast<const char *>(size), sizeof(size));
+  file.write(reinterpret_cast<const char *>(tilemap.data()),
+             static_cast<size_t>(tilemap.width()) * tilemap.height() *
+                 sizeof(Tile));
+  return file.good();
+}
+
+bool readDump(const std::string &path, Tilemap &tilemap) {
+  std::ifstream file(path, std::ios::binary);
+  int32_t size[2] = {};
+  if (!file.read(reinterpret_cast<char *>(size), sizeof(size))) {
+    return false;
+  }
+  Tilemap loaded(size[0], size[1]);
+  for (int y = 0; y < loaded.height(); y++) {
+    file.read(reinterpret_cast<char *>(loaded.row(y)),
+              loaded.width() * sizeof(Tile));
+  }
+  tilemap = std::move(loaded);
+  return file.good();
+}
+
+long fileSize(const std::string &path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  return static_cast<long>(file.tellg());
+}
+
+// grass everywhere with patches of other ground, winding empty rivers and
+// scattered single tiles, roughly what a hand-made world looks like
+Tilemap terrainMap(int size) {
+  Tilemap tilemap(size, size);
+  tilemap.fill(1);
+
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<int> coordinate(0, size - 1);
+  std::uniform_int_distribution<int> patchSize(4, 64);
+  std::uniform_int_distribution<int> type(2, 6);
+  for (int i = 0; i < size * size / 2048; i++) {
+    tilemap.fillRect(coordinate(random), coordinate(random),
+                     patchSize(random), patchSize(random),
+                     static_cast<uint16_t>(type(random)));
+  }
+  for (int river = 0; river < size / 256; river++) {
+    int x = coordinate(random);
+    for (int y = 0; y < size; y++) {
+      x += static_cast<int>(random() % 3) - 1;
+      tilemap.fillRect(x, y, 3, 1, 0);
+    }
+  }
+  for (int i = 0; i < size * size / 64; i++) {
+    tilemap.setTile(coordinate(random), coordinate(random),
+                    static_cast<uint16_t>(type(random)));
+  }
+  return tilemap;
+}
+
+// every tile random, runs never pay off and every chunk is stored raw
+Tilemap noiseMap(int size) {
+  Tilemap tilemap(size, size);
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<int> type(0, 3);
+  for (int y = 0; y < size; y++) {
+    Tile *row = tilemap.row(y);
+    for (int x = 0; x < size; x++) {
+      row[x].type = static_cast<uint16_t>(type(random));
+    }
+  }
+  return tilemap;
+}
+
+bool sameTiles(const Tilemap &a, const Tilemap &b) {
+  if (a.width() != b.width() || a.height() != b.height()) {
+    return false;
+  }
+  for (int y = 0; y < a.height(); y++) {
+    for (int x = 0; x < a.width(); x++) {
+      if (a.at(x, y).type != b.at(x, y).type) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void bench(const char *name, const Tilemap &tilemap,
+           const std::string &directory) {
+  std::string dumpPath = directory + "/bench.dump";
+  std::string mapPath = directory + "/bench.vmap";
+
+  bool dumpWritten = false, mapWritten = false;
+  double dumpSaveMs =
+      milliseconds([&] { dumpWritten = writeDump(dumpPath, tilemap); });
+  double mapSaveMs =
+      milliseconds([&] { mapWritten = mapfile::write(mapPath, tilemap); });
+
+  if (!dumpWritten || !mapWritten) {
+    std::cout << "cannot write to " << directory << "\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  Tilemap fromDump, fromMap;
+  bool dumpRead = false, mapRead = false;
+  double dumpLoadMs =
+      milliseconds([&] { dumpRead = readDump(dumpPath, fromDump); });
+  double mapLoadMs =
+      milliseconds([&] { mapRead = mapfile::load(mapPath, fromMap); });
+
+  // what loadMap and the first streamTileChunks do: map the file, allocate
+  // the empty map and decode a 4x3 block of chunks, about what the default
+  // camera and its one chunk margin touch
+  bool mapped = false;
+  const int chunkCount = 12;
+  double allocateMs = milliseconds(
+      [&] { Tilemap empty(tilemap.width(), tilemap.height()); });
+  Tilemap streamed(tilemap.width(), tilemap.height());
+  double streamMs = milliseconds([&] {
+    texfile::MappedFile file;
+    mapfile::MapView view;
+    mapped = file.open(mapPath, false) && mapfile::parse(file, view);
+    for (int chunk = 0; chunk < chunkCount && mapped; chunk++) {
+      uint32_t index = static_cast<uint32_t>(
+          chunk / 4 * streamed.chunksX() + chunk % 4);
+      mapfile::decodeChunk(view, index, streamed);
+    }
+  });
+
+  if (!dumpRead || !mapRead || !mapped || !sameTiles(tilemap, fromDump) ||
+      !sameTiles(tilemap, fromMap)) {
+    std::cout << name << ": round trip failed\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  long dumpBytes = fileSize(dumpPath);
+  long mapBytes = fileSize(mapPath);
+  std::cout << name << " " << tilemap.width() << "x" << tilemap.height()
+            << "\n"
+            << "  size  " << dumpBytes / 1024 << " KiB -> " << mapBytes / 1024
+            << " KiB (" << static_cast<double>(dumpBytes) / mapBytes
+            << "x smaller)\n"
+            << "  save  " << dumpSaveMs << " ms -> " << mapSaveMs << " ms\n"
+            << "  load  " << dumpLoadMs << " ms -> " << mapLoadMs
+            << " ms (all chunks)\n"
+            << "  first screen " << allocateMs << " ms to allocate the empty "
+            << "map + " << streamMs << " ms to map the file and decode "
+            << chunkCount << " chunks\n";
+
+  std::remove(dumpPath.c_str());
+  std::remove(mapPath.c_str());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int size = argc > 1 ? std::stoi(argv[1]) : 4096;
+  std::string directory = argc > 2 ? argv[2] : ".";
+
+  Tilemap filled(size, size);
+  filled.fill(1);
+  bench("filled", filled, directory);
+  bench("terrain", terrainMap(size), directory);
+  bench("noise", noiseMap(size), directory);
+  return EXIT_SUCCESS;
+}
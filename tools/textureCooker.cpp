@@ -0,0 +1,355 @@
+// Offline texture cooker: decodes a source image once, builds the full mip
+// chain and writes it in the final VkFormat as a .vtex container.
+//
+//   TextureCooker [--bc] [--no-mips] <input> <output.vtex>
+//   TextureCooker --bench <input> <cooked.vtex> [iterations]
+
+#include "../src/textureFile.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#define STB_IMAGE_IMPLEMENTATION
+#include "../src/stb_image.h"
+
+namespace {
+
+struct Image {
+  uint32_t width;
+  uint32_t height;
+  std::vector<uint8_t> pixels; // RGBA8, sRGB encoded
+};
+
+float srgbToLinear(uint8_t value) {
+  float c = value / 255.0f;
+  return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+uint8_t linearToSrgb(float c) {
+  c = std::clamp(c, 0.0f, 1.0f);
+  float s = c <= 0.0031308f ? c * 12.92f
+                            : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+  return static_cast<uint8_t>(s * 255.0f + 0.5f);
+}
+
+// 2x2 box filter in linear space, alpha filtered linearly
+Image downsample(const Image &src, const std::array<float, 256> &toLinear) {
+  Image dst;
+  dst.width = std::max(1u, src.width / 2);
+  dst.height = std::max(1u, src.height / 2);
+  dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+  for (uint32_t y = 0; y < dst.height; y++) {
+    for (uint32_t x = 0; x < dst.width; x++) {
+      uint32_t x0 = std::min(x * 2, src.width - 1);
+      uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+      uint32_t y0 = std::min(y * 2, src.height - 1);
+      uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+      const uint8_t *p[4] = {
+          &src.pixels[(static_cast<size_t>(y0) * src.width + x0) * 4],
+          &src.pixels[(static_cast<size_t>(y0) * src.width + x1) * 4],
+          &src.pixels[(static_cast<size_t>(y1) * src.width + x0) * 4],
+          &src.pixels[(static_cast<size_t>(y1) * src.width + x1) * 4]};
+
+      uint8_t *out = &dst.pixels[(static_cast<size_t>(y) * dst.width + x) * 4];
+      for (int c = 0; c < 3; c++) {
+        float sum = toLinear[p[0][c]] + toLinear[p[1][c]] +
+                    toLinear[p[2][c]] + toLinear[p[3][c]];
+        out[c] = linearToSrgb(sum * 0.25f);
+      }
+      out[3] = static_cast<uint8_t>((p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2) /
+                                    4);
+    }
+  }
+  return dst;
+}
+
+uint16_t packRgb565(const uint8_t *c) {
+  return static_cast<uint16_t>(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) |
+                               (c[2] >> 3));
+}
+
+void unpackRgb565(uint16_t v, int *c) {
+  c[0] = ((v >> 11) & 31) * 255 / 31;
+  c[1] = ((v >> 5) & 63) * 255 / 63;
+  c[2] = (v & 31) * 255 / 31;
+}
+
+// bounding-box endpoint fit, always the 4 colour mode
+void encodeColorBlock(const uint8_t block[16][4], uint8_t *out) {
+  uint8_t lo[3] = {255, 255, 255};
+  uint8_t hi[3] = {0, 0, 0};
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 3; c++) {
+      lo[c] = std::min(lo[c], block[i][c]);
+      hi[c] = std::max(hi[c], block[i][c]);
+    }
+  }
+  // inset the box by 1/16 to reduce the error from the endpoints
+  for (int c = 0; c < 3; c++) {
+    int inset = (hi[c] - lo[c]) / 16;
+    lo[c] = static_cast<uint8_t>(lo[c] + inset);
+    hi[c] = static_cast<uint8_t>(hi[c] - inset);
+  }
+
+  uint16_t c0 = packRgb565(hi);
+  uint16_t c1 = packRgb565(lo);
+  if (c0 < c1) {
+    std::swap(c0, c1);
+  }
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    int palette[4][3];
+    unpackRgb565(c0, palette[0]);
+    unpackRgb565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for (int i = 0; i < 16; i++) {
+      int best = 0;
+      int bestDist = INT32_MAX;
+      for (int p = 0; p < 4; p++) {
+        int dist = 0;
+        for (int c = 0; c < 3; c++) {
+          int d = block[i][c] - palette[p][c];
+          dist += d * d;
+        }
+        if (dist < bestDist) {
+          bestDist = dist;
+          best = p;
+        }
+      }
+      indices |= static_cast<uint32_t>(best) << (i * 2);
+    }
+  }
+
+  out[0] = static_cast<uint8_t>(c0 & 0xff);
+  out[1] = static_cast<uint8_t>(c0 >> 8);
+  out[2] = static_cast<uint8_t>(c1 & 0xff);
+  out[3] = static_cast<uint8_t>(c1 >> 8);
+  std::memcpy(out + 4, &indices, sizeof(indices));
+}
+
+// BC3 alpha block using the 8 value interpolation mode
+void encodeAlphaBlock(const uint8_t block[16][4], uint8_t *out) {
+  uint8_t a0 = 0;
+  uint8_t a1 = 255;
+  for (int i = 0; i < 16; i++) {
+    a0 = std::max(a0, block[i][3]);
+    a1 = std::min(a1, block[i][3]);
+  }
+
+  out[0] = a0;
+  out[1] = a1;
+
+  int palette[8];
+  palette[0] = a0;
+  palette[1] = a1;
+  for (int i = 1; i < 7; i++) {
+    palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+  }
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 16; i++) {
+    int best = 0;
+    int bestDist = INT32_MAX;
+    for (int p = 0; p < 8; p++) {
+      int dist = std::abs(block[i][3] - palette[p]);
+      if (dist < bestDist) {
+        bestDist = dist;
+        best = p;
+      }
+    }
+    indices |= static_cast<uint64_t>(best) << (i * 3);
+  }
+
+  for (int i = 0; i < 6; i++) {
+    out[2 + i] = static_cast<uint8_t>((indices >> (i * 8)) & 0xff);
+  }
+}
+
+std::vector<uint8_t> compressBC(const Image &image, bool withAlpha) {
+  uint32_t blocksX = (image.width + 3) / 4;
+  uint32_t blocksY = (image.height + 3) / 4;
+  size_t blockBytes = withAlpha ? 16 : 8;
+  std::vector<uint8_t> out(blocksX * blocksY * blockBytes);
+
+  uint8_t block[16][4];
+  for (uint32_t by = 0; by < blocksY; by++) {
+    for (uint32_t bx = 0; bx < blocksX; bx++) {
+      for (uint32_t i = 0; i < 16; i++) {
+        uint32_t x = std::min(bx * 4 + i % 4, image.width - 1);
+        uint32_t y = std::min(by * 4 + i / 4, image.height - 1);
+        std::memcpy(block[i],
+                    &image.pixels[(static_cast<size_t>(y) * image.width + x) *
+                                  4],
+                    4);
+      }
+
+      uint8_t *dst = &out[(by * blocksX + bx) * blockBytes];
+      if (withAlpha) {
+        encodeAlphaBlock(block, dst);
+        encodeColorBlock(block, dst + 8);
+      } else {
+        encodeColorBlock(block, dst);
+      }
+    }
+  }
+  return out;
+}
+
+bool hasAlpha(const Image &image) {
+  for (size_t i = 3; i < image.pixels.size(); i += 4) {
+    if (image.pixels[i] != 255) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool loadSource(const char *path, Image &image) {
+  int width, height, channels;
+  stbi_uc *pixels = stbi_load(path, &width, &height, &channels, STBI_rgb_alpha);
+  if (!pixels) {
+    return false;
+  }
+  image.width = static_cast<uint32_t>(width);
+  image.height = static_cast<uint32_t>(height);
+  image.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+  stbi_image_free(pixels);
+  return true;
+}
+
+int cook(const char *input, const char *output, bool blockCompress,
+         bool mips) {
+  Image image;
+  if (!loadSource(input, image)) {
+    std::cerr << "failed to load " << input << ": " << stbi_failure_reason()
+              << "\n";
+    return EXIT_FAILURE;
+  }
+
+  std::array<float, 256> toLinear;
+  for (int i = 0; i < 256; i++) {
+    toLinear[i] = srgbToLinear(static_cast<uint8_t>(i));
+  }
+
+  bool alpha = hasAlpha(image);
+  VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+  if (blockCompress) {
+    format = alpha ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+  }
+
+  std::vector<std::vector<uint8_t>> levels;
+  uint32_t width = image.width;
+  uint32_t height = image.height;
+  Image level = std::move(image);
+  while (true) {
+    levels.push_back(blockCompress ? compressBC(level, alpha) : level.pixels);
+    if (!mips || (level.width == 1 && level.height == 1)) {
+      break;
+    }
+    level = downsample(level, toLinear);
+  }
+
+  if (!texfile::write(output, format, width, height, levels)) {
+    std::cerr << "failed to write " << output << "\n";
+    return EXIT_FAILURE;
+  }
+
+  std::cout << input << " -> " << output << " (" << width << "x" << height
+            << ", " << levels.size() << " mips"
+            << (blockCompress ? (alpha ? ", BC3" : ", BC1") : "") << ")\n";
+  return EXIT_SUCCESS;
+}
+
+// Compares what createTextureImage does per texture on the CPU: decode +
+// copy into staging for source images, map + copy for cooked ones.
+int bench(const char *source, const char *cooked, int iterations) {
+  using clock = std::chrono::high_resolution_clock;
+  std::vector<uint8_t> staging;
+
+  auto decodeStart = clock::now();
+  for (int i = 0; i < iterations; i++) {
+    int width, height, channels;
+    stbi_uc *pixels =
+        stbi_load(source, &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+      std::cerr << "failed to load " << source << "\n";
+      return EXIT_FAILURE;
+    }
+    size_t size = static_cast<size_t>(width) * height * 4;
+    staging.resize(size);
+    std::memcpy(staging.data(), pixels, size);
+    stbi_image_free(pixels);
+  }
+  double decodeMs =
+      std::chrono::duration<double, std::milli>(clock::now() - decodeStart)
+          .count();
+
+  auto cookedStart = clock::now();
+  for (int i = 0; i < iterations; i++) {
+    texfile::MappedFile file;
+    texfile::TextureView view;
+    if (!file.open(cooked) || !texfile::parse(file, view)) {
+      std::cerr << "failed to open cooked texture " << cooked << "\n";
+      return EXIT_FAILURE;
+    }
+    staging.resize(view.header->payloadSize);
+    std::memcpy(staging.data(), view.payload, view.header->payloadSize);
+  }
+  double cookedMs =
+      std::chrono::duration<double, std::milli>(clock::now() - cookedStart)
+          .count();
+
+  std::cout << "decode " << source << ": " << decodeMs / iterations
+            << " ms/texture\n";
+  std::cout << "cooked " << cooked << ": " << cookedMs / iterations
+            << " ms/texture (all mips)\n";
+  return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  if (!args.empty() && args[0] == "--bench") {
+    if (args.size() < 3) {
+      std::cerr << "usage: TextureCooker --bench <input> <cooked.vtex> "
+                   "[iterations]\n";
+      return EXIT_FAILURE;
+    }
+    int iterations = args.size() > 3 ? std::max(1, std::stoi(args[3])) : 20;
+    return bench(args[1].c_str(), args[2].c_str(), iterations);
+  }
+
+  bool blockCompress = false;
+  bool mips = true;
+  std::vector<std::string> paths;
+  for (const auto &arg : args) {
+    if (arg == "--bc") {
+      blockCompress = true;
+    } else if (arg == "--no-mips") {
+      mips = false;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+
+  if (paths.size() != 2) {
+    std::cerr << "usage: TextureCooker [--bc] [--no-mips] <input> "
+                 "<output.vtex>\n";
+    return EXIT_FAILURE;
+  }
+
+  return cook(paths[0].c_str(), paths[1].c_str(), blockCompress, mips);
+}
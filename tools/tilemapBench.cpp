@@ -0,0 +1,222 @@
+// Compares the flat row-major Tilemap with the old row-of-rows layout
+// (std::vector<std::vector<Tile>>, bounds checked on every access): filling
+// the map, random reads and building the mesh of every 32x32 chunk.
+//
+//   TilemapBench [map sizes...]      default: 1024 4096
+
+#include "../src/tilemap.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Tilemap before the flat storage.
+struct LegacyTilemap {
+  std::vector<std::vector<Tile>> tiles;
+  int width;
+  int height;
+
+  LegacyTilemap(int w, int h) : width(w), height(h) {
+    tiles.resize(height, std::vector<Tile>(width));
+
+    for (auto &row : tiles) {
+      for (auto &tile : row) {
+        tile.type = 0;
+      }
+    }
+  }
+
+  void setTile(int x, int y, uint16_t type) {
+    if (x >= 0 && x < width && y >= 0 && y < height) {
+      tiles[y][x].type = type;
+    }
+  }
+
+  Tile getTile(int x, int y) const {
+    if (x >= 0 && x < width && y >= 0 && y < height) {
+      return tiles[y][x];
+    }
+
+    return Tile{0};
+  }
+};
+
+// the old createTilemapMesh loop over one chunk
+void legacyBuildChunk(const LegacyTilemap &tilemap, int chunkX, int chunkY,
+                      std::vector<vertexData::Vertex> &vertices,
+                      std::vector<uint32_t> &indices) {
+  float tileSize = 1.0f;
+  int atlasColums = 1;
+  int atlasRows = 1;
+  glm::vec3 tileColor(1.0f, 1.0f, 1.0f);
+
+  int startX = chunkX * Tilemap::chunkSize;
+  int startY = chunkY * Tilemap::chunkSize;
+  int endX = std::min(startX + Tilemap::chunkSize, tilemap.width);
+  int endY = std::min(startY + Tilemap::chunkSize, tilemap.height);
+
+  for (int y = startY; y < endY; y++) {
+    for (int x = startX; x < endX; x++) {
+      Tile tile = tilemap.getTile(x, y);
+      if (tile.type == 0)
+        continue;
+
+      float u1 = (float)((tile.type - 1) % atlasColums) / atlasColums;
+      float v1 = (float)((tile.type - 1) / atlasColums) / atlasRows;
+      float u2 = u1 + 1.0f / atlasColums;
+      float v2 = v1 + 1.0f / atlasRows;
+
+      float left = (x - startX) * tileSize - 0.5f;
+      float bottom = (y - startY) * tileSize - 0.5f;
+      glm::vec2 pos1(left, bottom);
+      glm::vec2 pos2(left + tileSize, bottom);
+      glm::vec2 pos3(left + tileSize, bottom + tileSize);
+      glm::vec2 pos4(left, bottom + tileSize);
+
+      uint32_t baseIndex = static_cast<uint32_t>(vertices.size());
+
+      vertices.push_back({pos1, tileColor, {u1, v1}});
+      vertices.push_back({pos2, tileColor, {u2, v1}});
+      vertices.push_back({pos3, tileColor, {u2, v2}});
+      vertices.push_back({pos4, tileColor, {u1, v2}});
+
+      indices.push_back(baseIndex);
+      indices.push_back(baseIndex + 1);
+      indices.push_back(baseIndex + 2);
+      indices.push_back(baseIndex);
+      indices.push_back(baseIndex + 2);
+      indices.push_back(baseIndex + 3);
+    }
+  }
+}
+
+template <typename F> double milliseconds(int iterations, F &&work) {
+  using clock = std::chrono::high_resolution_clock;
+  work(); // warm up
+  auto start = clock::now();
+  for (int i = 0; i < iterations; i++) {
+    work();
+  }
+  return std::chrono::duration<double, std::milli>(clock::now() - start)
+             .count() /
+         iterations;
+}
+
+void report(const char *name, double legacyMs, double flatMs) {
+  std::cout << "  " << name << legacyMs << " ms -> " << flatMs << " ms ("
+            << legacyMs / flatMs << "x)\n";
+}
+
+void bench(int size) {
+  int iterations = std::max(1, 4096 * 4096 / (size * size));
+
+  LegacyTilemap legacy(size, size);
+  Tilemap flat(size, size);
+
+  double legacyFillMs = milliseconds(iterations, [&] {
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        legacy.setTile(x, y, 1);
+      }
+    }
+  });
+  double flatFillMs = milliseconds(iterations, [&] { flat.fill(1); });
+
+  // a quarter of the map empty, types 1-3 elsewhere
+  std::mt19937 random(1234);
+  std::uniform_int_distribution<int> type(0, 3);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      uint16_t t = static_cast<uint16_t>(type(random));
+      legacy.setTile(x, y, t);
+      flat.setTile(x, y, t);
+    }
+  }
+
+  const size_t reads = 1 << 22;
+  std::uniform_int_distribution<int> coordinate(0, size - 1);
+  std::vector<int> xs(reads), ys(reads);
+  for (size_t i = 0; i < reads; i++) {
+    xs[i] = coordinate(random);
+    ys[i] = coordinate(random);
+  }
+
+  // the sums keep the reads from being optimized away
+  uint64_t legacySum = 0, flatSum = 0, uncheckedSum = 0;
+  double legacyReadMs = milliseconds(iterations, [&] {
+    for (size_t i = 0; i < reads; i++) {
+      legacySum += legacy.getTile(xs[i], ys[i]).type;
+    }
+  });
+  double flatReadMs = milliseconds(iterations, [&] {
+    for (size_t i = 0; i < reads; i++) {
+      flatSum += flat.getTile(xs[i], ys[i]).type;
+    }
+  });
+  double uncheckedReadMs = milliseconds(iterations, [&] {
+    for (size_t i = 0; i < reads; i++) {
+      uncheckedSum += flat.at(xs[i], ys[i]).type;
+    }
+  });
+
+  std::vector<vertexData::Vertex> vertices;
+  std::vector<uint32_t> indices;
+  size_t legacyVertices = 0, flatVertices = 0;
+  double legacyBuildMs = milliseconds(iterations, [&] {
+    legacyVertices = 0;
+    for (int chunkY = 0; chunkY < flat.chunksY(); chunkY++) {
+      for (int chunkX = 0; chunkX < flat.chunksX(); chunkX++) {
+        vertices.clear();
+        indices.clear();
+        legacyBuildChunk(legacy, chunkX, chunkY, vertices, indices);
+        legacyVertices += vertices.size();
+      }
+    }
+  });
+  double flatBuildMs = milliseconds(iterations, [&] {
+    flatVertices = 0;
+    for (int chunkY = 0; chunkY < flat.chunksY(); chunkY++) {
+      for (int chunkX = 0; chunkX < flat.chunksX(); chunkX++) {
+        vertices.clear();
+        indices.clear();
+        tilemapMesh::buildChunk(flat, chunkX, chunkY, 1, 1, vertices, indices);
+        flatVertices += vertices.size();
+      }
+    }
+  });
+
+  if (legacySum != flatSum || flatSum != uncheckedSum ||
+      legacyVertices != flatVertices) {
+    std::cout << "layouts disagree\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  std::cout << size << "x" << size << " tiles, " << iterations
+            << " iterations\n";
+  report("fill             ", legacyFillMs, flatFillMs);
+  report("4M random reads  ", legacyReadMs, flatReadMs);
+  report("  unchecked at() ", legacyReadMs, uncheckedReadMs);
+  report("chunk mesh build ", legacyBuildMs, flatBuildMs);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<int> sizes;
+  for (int i = 1; i < argc; i++) {
+    sizes.push_back(std::stoi(argv[i]));
+  }
+  if (sizes.empty()) {
+    sizes = {1024, 4096};
+  }
+
+  for (int size : sizes) {
+    bench(size);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,136 @@
+// Compares the per-frame transform update of the old interleaved Mesh
+// (Mesh::update: integrate, then translate * rotate * scale as glm::mat4)
+// with the TransformSoA kernels, scalar and AVX2.
+//
+//   TransformBench [entity counts...]      default: 1000 100000 1000000
+
+#include "../src/animation.hpp"
+#include "../src/transformKernels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Same fields and order as Mesh before the SoA split, handles as pointers.
+struct LegacyMesh {
+  void *vertexBuffer = nullptr;
+  void *vertexBufferMemory = nullptr;
+  void *indexBuffer = nullptr;
+  void *indexBufferMemory = nullptr;
+  uint16_t indexCount = 0;
+
+  uint32_t textureId = 0;
+  SpriteAnimation animation;
+
+  glm::mat4 transform = glm::mat4(1.0f);
+  glm::vec3 position = glm::vec3(0.0f);
+  glm::vec3 velocity = glm::vec3(0.0f);
+  float rotation = 0.0f;
+  glm::vec3 scale = glm::vec3(1.0f);
+
+  bool plyerMesh = false;
+
+  void update(float deltaTime) {
+    position += velocity * deltaTime;
+    transform = glm::translate(glm::mat4(1.0f), position) *
+                glm::rotate(glm::mat4(1.0f), rotation, glm::vec3(0, 0, 1)) *
+                glm::scale(glm::mat4(1.0f), scale);
+  }
+};
+
+template <typename F>
+double timePerEntityNs(size_t count, int iterations, F &&frame) {
+  using clock = std::chrono::high_resolution_clock;
+  frame(); // warm up
+  auto start = clock::now();
+  for (int i = 0; i < iterations; i++) {
+    frame();
+  }
+  double ns =
+      std::chrono::duration<double, std::nano>(clock::now() - start).count();
+  return ns / (static_cast<double>(iterations) * count);
+}
+
+void bench(size_t count) {
+  const float deltaTime = 1.0f / 60.0f;
+  size_t work = 20000000 / std::max<size_t>(count, 1);
+  int iterations = static_cast<int>(std::max<size_t>(5, work));
+
+  std::mt19937 random(1234);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+  std::vector<LegacyMesh> meshes(count);
+  TransformSoA soa;
+  soa.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    float x = unit(random) * 100.0f, y = unit(random) * 100.0f;
+    float vx = unit(random), vy = unit(random);
+    float rotation = unit(random) * 3.14159265f;
+    float scale = 0.5f + unit(random) * 0.25f;
+
+    meshes[i].position = glm::vec3(x, y, 0.0f);
+    meshes[i].velocity = glm::vec3(vx, vy, 0.0f);
+    meshes[i].rotation = rotation;
+    meshes[i].scale = glm::vec3(scale, scale, 1.0f);
+
+    soa.x[i] = x;
+    soa.y[i] = y;
+    soa.vx[i] = vx;
+    soa.vy[i] = vy;
+    soa.rot[i] = rotation;
+    soa.sx[i] = scale;
+    soa.sy[i] = scale;
+  }
+
+  double legacyNs = timePerEntityNs(count, iterations, [&] {
+    for (auto &mesh : meshes) {
+      mesh.update(deltaTime);
+    }
+  });
+
+  double scalarNs = timePerEntityNs(count, iterations, [&] {
+    transformKernels::integrateScalar(soa, 0, count, deltaTime);
+    transformKernels::buildAffineScalar(soa, 0, count);
+  });
+
+  std::cout << count << " entities, " << iterations << " frames\n";
+  std::cout << "  Mesh::update     " << legacyNs << " ns/entity\n";
+  std::cout << "  soa scalar       " << scalarNs << " ns/entity ("
+            << legacyNs / scalarNs << "x)\n";
+
+  if (!transformKernels::hasAvx2()) {
+    std::cout << "  soa avx2         unsupported on this cpu\n";
+    return;
+  }
+
+  double avx2Ns = timePerEntityNs(count, iterations, [&] {
+    transformKernels::integrateAvx2(soa, 0, count, deltaTime);
+    transformKernels::buildAffineAvx2(soa, 0, count);
+  });
+  std::cout << "  soa avx2         " << avx2Ns << " ns/entity ("
+            << legacyNs / avx2Ns << "x)\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::vector<size_t> counts;
+  for (int i = 1; i < argc; i++) {
+    counts.push_back(static_cast<size_t>(std::stoull(argv[i])));
+  }
+  if (counts.empty()) {
+    counts = {1000, 100000, 1000000};
+  }
+
+  for (size_t count : counts) {
+    bench(count);
+  }
+  return EXIT_SUCCESS;
+}